@@ -0,0 +1,192 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+// Counts every heap allocation made through operator new, so tests and
+// benchmarks can check how many allocations an operation performs.
+//
+// This header REPLACES the global operator new/delete. Include it in exactly
+// one translation unit of a test or benchmark program, never from another
+// header.
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+
+static std::atomic<uint64_t> allocCounterCount(0);
+static std::atomic<uint64_t> allocCounterBytes(0);
+
+/**
+* Counts allocations made between its construction and the call to
+* allocations()/bytes(), e.g.
+*
+*   AllocScope scope;
+*   tree.find(k);
+*   assert(scope.allocations() == 0);
+*/
+class AllocScope
+{
+public:
+    AllocScope() :
+        startCount_(allocCounterCount.load(std::memory_order_relaxed)),
+        startBytes_(allocCounterBytes.load(std::memory_order_relaxed))
+    {
+
+    }
+
+    uint64_t allocations() const
+    {
+        return allocCounterCount.load(std::memory_order_relaxed) - startCount_;
+    }
+
+    uint64_t bytes() const
+    {
+        return allocCounterBytes.load(std::memory_order_relaxed) - startBytes_;
+    }
+
+private:
+    uint64_t startCount_;
+    uint64_t startBytes_;
+};
+
+// GCC flags free() on memory from the replaced operator new, which is
+// exactly what these replacements intend.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+// Every replaced form below allocates through this and frees with
+// std::free, so any new may be paired with any delete the language picks:
+// the nothrow and aligned forms must be replaced too, or the library's
+// versions would free memory malloc'ed here (std::stable_sort's buffer
+// comes from nothrow new). Returns NULL on failure.
+static void* allocCounterAllocate(std::size_t size, std::size_t alignment)
+{
+    allocCounterCount.fetch_add(1, std::memory_order_relaxed);
+    allocCounterBytes.fetch_add(size, std::memory_order_relaxed);
+    if (!size)
+    {
+        size = 1;
+    }
+    if (alignment <= alignof(std::max_align_t))
+    {
+        return std::malloc(size);
+    }
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* operator new(std::size_t size)
+{
+    void* p = allocCounterAllocate(size, 0);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocCounterAllocate(size, 0);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocCounterAllocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    void* p = allocCounterAllocate(size, static_cast<std::size_t>(alignment));
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocCounterAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocCounterAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+// C++14 sized deallocation calls these instead of the unsized forms.
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef AUGMENTED_AVLBST_H
+#define AUGMENTED_AVLBST_H
+
+#include <algorithm>
+#include <limits>
+#include <functional>
+#include "avlbst.h"
+
+/**
+* Augmentation policies for AugmentedAVLTree. A policy is a monoid: a
+* Summary type with an identity and an associative combine, plus lift,
+* which summarizes one item. combine is always called with its arguments
+* in key order, so it need not be commutative.
+*/
+template <typename Value>
+struct SumMonoid
+{
+    typedef Value Summary;
+    static Summary identity() { return Summary(); }
+    template<typename Key>
+    static Summary lift(const Key&, const Value& value) { return value; }
+    static Summary combine(const Summary& a, const Summary& b) { return a + b; }
+};
+
+template <typename Value>
+struct MinMonoid
+{
+    typedef Value Summary;
+    static Summary identity() { return std::numeric_limits<Value>::max(); }
+    template<typename Key>
+    static Summary lift(const Key&, const Value& value) { return value; }
+    static Summary combine(const Summary& a, const Summary& b) { return std::min(a, b); }
+};
+
+template <typename Value>
+struct MaxMonoid
+{
+    typedef Value Summary;
+    static Summary identity() { return std::numeric_limits<Value>::lowest(); }
+    template<typename Key>
+    static Summary lift(const Key&, const Value& value) { return value; }
+    static Summary combine(const Summary& a, const Summary& b) { return std::max(a, b); }
+};
+
+/**
+* An AVL node that also stores the summary of its whole subtree.
+*/
+template <typename Key, typename Value, typename Summary>
+class AugmentedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    AugmentedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent, const Summary& summary);
+
+    const Summary& getSummary() const;
+    void setSummary(const Summary& summary);
+
+protected:
+    Summary summary_;
+};
+
+/*
+  -----------------------------------------------------
+  Begin implementations for the AugmentedAVLNode class.
+  -----------------------------------------------------
+*/
+
+template<class Key, class Value, class Summary>
+AugmentedAVLNode<Key, Value, Summary>::AugmentedAVLNode(const Key& key, const Value& value,
+                                                        AVLNode<Key, Value>* parent, const Summary& summary) :
+    AVLNode<Key, Value>(key, value, parent), summary_(summary)
+{
+
+}
+
+template<class Key, class Value, class Summary>
+const Summary& AugmentedAVLNode<Key, Value, Summary>::getSummary() const
+{
+    return summary_;
+}
+
+template<class Key, class Value, class Summary>
+void AugmentedAVLNode<Key, Value, Summary>::setSummary(const Summary& summary)
+{
+    summary_ = summary;
+}
+
+/*
+  ---------------------------------------------------
+  End implementations for the AugmentedAVLNode class.
+  ---------------------------------------------------
+*/
+
+/**
+* An AVLTree whose nodes keep Monoid::combine over their subtree's items
+* (lazily deleted items count as the identity), which answers range
+* aggregates in O(log n): aggregate(lo, hi) combines the summaries of the
+* O(log n) subtrees that exactly cover [lo, hi).
+*
+* Summaries are kept up to date through AVLTree's refresh hooks: each
+* rotation recomputes the two rotated nodes, and every insert, update and
+* remove recomputes the path from the changed node to the root, so point
+* updates cost O(log n). Change values through insert only; writing
+* through operator[] or an iterator bypasses the summaries.
+*/
+template <class Key, class Value, class Monoid, class Compare = std::less<Key> >
+class AugmentedAVLTree : public AVLTree<Key, Value, Compare>
+{
+public:
+    typedef typename Monoid::Summary Summary;
+
+    explicit AugmentedAVLTree(const Compare& compare = Compare());
+
+    Summary aggregate() const;
+    Summary aggregate(const Key& lo, const Key& hi) const;
+
+protected:
+    typedef AugmentedAVLNode<Key, Value, Summary> AugNode;
+
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual size_t nodeSize() const;
+    virtual void refreshNode(AVLNode<Key, Value>* node);
+    virtual void refreshPath(AVLNode<Key, Value>* node);
+
+    static const Summary& summaryOf(const Node<Key, Value>* node, const Summary& identity);
+    static Summary itemSummary(const Node<Key, Value>* node);
+    bool less(const Key& a, const Key& b) const;
+    Summary suffixFrom(const Node<Key, Value>* node, const Key& lo) const;
+    Summary prefixBefore(const Node<Key, Value>* node, const Key& hi) const;
+};
+
+/*
+  -----------------------------------------------------
+  Begin implementations for the AugmentedAVLTree class.
+  -----------------------------------------------------
+*/
+
+template<class Key, class Value, class Monoid, class Compare>
+AugmentedAVLTree<Key, Value, Monoid, Compare>::AugmentedAVLTree(const Compare& compare) :
+    AVLTree<Key, Value, Compare>(compare)
+{
+
+}
+
+/**
+* The summary of every item in the tree.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+typename AugmentedAVLTree<Key, Value, Monoid, Compare>::Summary
+AugmentedAVLTree<Key, Value, Monoid, Compare>::aggregate() const
+{
+    Summary identity = Monoid::identity();
+    return summaryOf(this->root_, identity);
+}
+
+/**
+* The summary of the items with lo <= key < hi, in O(log n): descend to
+* the first node inside the range, then combine the summaries hanging
+* inside the range off the paths towards lo and towards hi.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+typename AugmentedAVLTree<Key, Value, Monoid, Compare>::Summary
+AugmentedAVLTree<Key, Value, Monoid, Compare>::aggregate(const Key& lo, const Key& hi) const
+{
+    const Node<Key, Value>* node = this->root_;
+    while (node)
+    {
+        if (less(node->getKey(), lo))
+        {
+            node = node->getRight();
+        }
+        else if (!less(node->getKey(), hi))
+        {
+            node = node->getLeft();
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (!node)
+    {
+        return Monoid::identity();
+    }
+    return Monoid::combine(Monoid::combine(suffixFrom(node->getLeft(), lo), itemSummary(node)),
+                           prefixBefore(node->getRight(), hi));
+}
+
+/**
+* The summary of the items with key >= lo in the subtree at node.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+typename AugmentedAVLTree<Key, Value, Monoid, Compare>::Summary
+AugmentedAVLTree<Key, Value, Monoid, Compare>::suffixFrom(const Node<Key, Value>* node, const Key& lo) const
+{
+    Summary identity = Monoid::identity();
+    Summary result = identity;
+    while (node)
+    {
+        if (less(node->getKey(), lo))
+        {
+            node = node->getRight();
+        }
+        else
+        {
+            result = Monoid::combine(Monoid::combine(itemSummary(node), summaryOf(node->getRight(), identity)),
+                                     result);
+            node = node->getLeft();
+        }
+    }
+    return result;
+}
+
+/**
+* The summary of the items with key < hi in the subtree at node.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+typename AugmentedAVLTree<Key, Value, Monoid, Compare>::Summary
+AugmentedAVLTree<Key, Value, Monoid, Compare>::prefixBefore(const Node<Key, Value>* node, const Key& hi) const
+{
+    Summary identity = Monoid::identity();
+    Summary result = identity;
+    while (node)
+    {
+        if (less(node->getKey(), hi))
+        {
+            result = Monoid::combine(result,
+                                     Monoid::combine(summaryOf(node->getLeft(), identity), itemSummary(node)));
+            node = node->getRight();
+        }
+        else
+        {
+            node = node->getLeft();
+        }
+    }
+    return result;
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+bool AugmentedAVLTree<Key, Value, Monoid, Compare>::less(const Key& a, const Key& b) const
+{
+    BST_COUNT(comparisons, 1);
+    return this->compare_(a, b);
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+const typename AugmentedAVLTree<Key, Value, Monoid, Compare>::Summary&
+AugmentedAVLTree<Key, Value, Monoid, Compare>::summaryOf(const Node<Key, Value>* node, const Summary& identity)
+{
+    return node ? static_cast<const AugNode*>(node)->getSummary() : identity;
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+typename AugmentedAVLTree<Key, Value, Monoid, Compare>::Summary
+AugmentedAVLTree<Key, Value, Monoid, Compare>::itemSummary(const Node<Key, Value>* node)
+{
+    if (node->isTombstone())
+    {
+        return Monoid::identity();
+    }
+    return Monoid::lift(node->getKey(), node->getValue());
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+Node<Key, Value>* AugmentedAVLTree<Key, Value, Monoid, Compare>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    Node<Key, Value>* node = new AugNode(key, value, static_cast<AVLNode<Key, Value>*>(parent), Monoid::lift(key, value));
+    ++this->size_;
+    return node;
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+size_t AugmentedAVLTree<Key, Value, Monoid, Compare>::nodeSize() const
+{
+    return sizeof(AugNode);
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::refreshNode(AVLNode<Key, Value>* node)
+{
+    Summary identity = Monoid::identity();
+    static_cast<AugNode*>(node)->setSummary(
+        Monoid::combine(Monoid::combine(summaryOf(node->getLeft(), identity), itemSummary(node)),
+                        summaryOf(node->getRight(), identity)));
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::refreshPath(AVLNode<Key, Value>* node)
+{
+    for (; node; node = node->getParent())
+    {
+        refreshNode(node);
+    }
+}
+
+/*
+  ---------------------------------------------------
+  End implementations for the AugmentedAVLTree class.
+  ---------------------------------------------------
+*/
+
+#endif
@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <vector>
 #include "bst.h"
 
 struct KeyError { };
@@ -28,6 +29,10 @@ public:
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
+    // Lazy deletion mark, see AVLTree::setLazyDelete.
+    virtual bool isTombstone() const override;
+    void setTombstone(bool tombstone);
+
     // Getters for parent, left, and right. These need to be redefined since they
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
@@ -37,6 +42,7 @@ public:
 
 protected:
     int8_t balance_;    // effectively a signed char
+    bool tombstone_;    // shares the padding after balance_
 };
 
 /*
@@ -51,7 +57,7 @@ protected:
 */
 template<class Key, class Value>
 AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+    Node<Key, Value>(key, value, parent), balance_(0), tombstone_(false)
 {
 
 }
@@ -92,6 +98,24 @@ void AVLNode<Key, Value>::updateBalance(int8_t diff)
     balance_ += diff;
 }
 
+/**
+* Whether the node has been lazily deleted.
+*/
+template<class Key, class Value>
+bool AVLNode<Key, Value>::isTombstone() const
+{
+    return tombstone_;
+}
+
+/**
+* Marks or unmarks the node as lazily deleted.
+*/
+template<class Key, class Value>
+void AVLNode<Key, Value>::setTombstone(bool tombstone)
+{
+    tombstone_ = tombstone;
+}
+
 /**
 * An overridden function for getting the parent since a static_cast is necessary to make sure
 * that our node is a AVLNode.
@@ -128,19 +152,41 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+template <class Key, class Value, class Compare = std::less<Key> >
+class AVLTree : public BinarySearchTree<Key, Value, Compare>
 {
 public:
+    explicit AVLTree(const Compare& compare = Compare());
+    using BinarySearchTree<Key, Value, Compare>::insert;
     virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
     virtual void remove(const Key& key);  // TODO
+
+    void setLazyDelete(bool enabled, double compactRatio = 1.0);
+    void compact();
+    size_t tombstones() const;
+
 protected:
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual Node<Key, Value>* insertOrFind(const Key& key, const Value& value, bool& added);
+    virtual size_t nodeSize() const;
+    virtual bool nodeBalance(const Node<Key, Value>* node, int& balance) const;
+    virtual void unlinkNode(Node<Key, Value>* node);
+    virtual Node<Key, Value>* linkNode(Node<Key, Value>* node);
 
     // Add helper functions here
     void rotateLeft(AVLNode<Key, Value>* node);
     void rotateRight(AVLNode<Key, Value>* node);
+
+    // Augmentation hooks (see AugmentedAVLTree): refreshNode recomputes
+    // per-node data from the node's children, refreshPath from node up to
+    // the root. Both do nothing here.
+    virtual void refreshNode(AVLNode<Key, Value>* node);
+    virtual void refreshPath(AVLNode<Key, Value>* node);
+    void refreshSubtree(AVLNode<Key, Value>* root);
     bool zigZig(const AVLNode<Key, Value>* node) const;
+    void overwrite(AVLNode<Key, Value>* node, const Value& value);
+    void attachLeaf(AVLNode<Key, Value>* parent, Node<Key, Value>* leaf, bool left);
     void insertFix(AVLNode<Key, Value>* node1, AVLNode<Key, Value>* node2);
     void removeFix(AVLNode<Key, Value>* node, int8_t diff);
     static AVLNode<Key, Value>* predecessor(AVLNode<Key, Value>* node);
@@ -151,93 +197,144 @@ protected:
     void removeZeroAVLChildren(AVLNode<Key, Value>* current);
     void removeWithLeftAVLChild(AVLNode<Key, Value>* current);
     void removeWithRightAVLChild(AVLNode<Key, Value>* current);
+
+    static AVLNode<Key, Value>* buildBalanced(std::vector<AVLNode<Key, Value>*>& nodes,
+                                              size_t first, size_t last,
+                                              AVLNode<Key, Value>* parent, int& height);
+
+    // trees smaller than this many tombstones are never compacted automatically
+    static const size_t MIN_AUTO_COMPACT = 64;
+
+    bool lazyDelete_;
+    double compactRatio_;
 };
 
+/**
+* Starts with lazy deletion off.
+*/
+template<class Key, class Value, class Compare>
+AVLTree<Key, Value, Compare>::AVLTree(const Compare& compare) :
+    BinarySearchTree<Key, Value, Compare>(compare), lazyDelete_(false), compactRatio_(1.0)
+{
+
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::insert (const std::pair<const Key, Value> &new_item)
 {
     // TODO
-    Key insertKey = new_item.first;
-    Value insertValue = new_item.second;
+    BST_COUNT(inserts, 1);
+    LatencyTimer timer(this->latency_, OP_INSERT);
 
-    if (this->root_ == nullptr)
+    bool added = false;
+    Node<Key, Value>* node = insertOrFind(new_item.first, new_item.second, added);
+    if (!added)
     {
-        this->root_ = new AVLNode<Key, Value>(insertKey, insertValue, nullptr);
+        // just reset the value
+        overwrite(static_cast<AVLNode<Key, Value>*>(node), new_item.second);
     }
-    else
+}
+
+/**
+* The AVL descent shared by insert and tryInsert: attaches and rebalances a
+* new leaf, or returns the live node already holding key untouched. A
+* lazily deleted node for key is revived with value and counts as added.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* AVLTree<Key, Value, Compare>::insertOrFind(const Key& key, const Value& value, bool& added)
+{
+    added = true;
+    if (this->root_ == nullptr)
     {
-        AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
-        bool beenInserted = false;
+        this->root_ = this->createNode(key, value, nullptr);
+        return this->root_;
+    }
 
-        while (!beenInserted)
+    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
+    while (true)
+    {
+        BST_COUNT(nodeVisits, 1);
+        BST_COUNT(comparisons, 1);
+        int cmp = KeyComparator<Compare>::compare(this->compare_, key, current->getKey());
+        if (cmp == 0)
         {
-            if (insertKey == current->getKey())
+            if (current->isTombstone())
             {
-                // just reset the value
-                current->setValue(insertValue);
-                beenInserted = true;
+                overwrite(current, value);
             }
-            else if (insertKey < current->getKey())
-            {
-                if (current->getLeft())
-                {
-                    current = current->getLeft();
-                }
-                else
-                {
-                    // make the new node a left child and update balance
-                    current->setLeft(new AVLNode<Key, Value>(insertKey, insertValue, current));
-                    beenInserted = true;
-                    current->setBalance(current->getBalance() - 1);
-                    current = current->getLeft();
-
-                    if (current->getParent()->getParent())
-                    {
-                        if (current->getParent()->getBalance() != 0)
-                        {
-                            this->insertFix(current->getParent(), current);
-                        }
-                    }
-                }
-            } 
             else
             {
-                if (current->getRight())
-                {
-                    current = current->getRight();
-                }
-                else
-                {
-                    // make the new node a right child and update balance
-                    current->setRight(new AVLNode<Key, Value>(insertKey, insertValue, current));
-                    beenInserted = true;
-                    current->setBalance(current->getBalance() + 1);
-                    current = current->getRight();
-
-                    if (current->getParent()->getParent())
-                    {
-                        if (current->getParent()->getBalance() != 0)
-                        {
-                            this->insertFix(current->getParent(), current);
-                        }
-                    }
-                }
+                added = false;
             }
+            return current;
+        }
+        AVLNode<Key, Value>* next = cmp < 0 ? current->getLeft() : current->getRight();
+        if (!next)
+        {
+            // make the new node a child and update balance
+            Node<Key, Value>* leaf = this->createNode(key, value, current);
+            attachLeaf(current, leaf, cmp < 0);
+            return leaf;
         }
+        current = next;
     }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* node1, AVLNode<Key, Value>* node2)
+/**
+* Stores a new value for a key that is already in the tree, reviving the
+* node if it was lazily deleted.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::overwrite(AVLNode<Key, Value>* node, const Value& value)
+{
+    if (node->isTombstone())
+    {
+        node->setTombstone(false);
+        --this->tombstones_;
+    }
+    node->setValue(value);
+    refreshPath(node);
+}
+
+/**
+* Hangs a freshly created leaf off parent (on the left or right), updates
+* the parent's balance and rebalances upwards. Shared by every insert
+* descent so that derived trees only need to find the attachment point.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::attachLeaf(AVLNode<Key, Value>* parent, Node<Key, Value>* leaf, bool left)
+{
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(leaf);
+    if (left)
+    {
+        parent->setLeft(node);
+        parent->setBalance(parent->getBalance() - 1);
+    }
+    else
+    {
+        parent->setRight(node);
+        parent->setBalance(parent->getBalance() + 1);
+    }
+
+    if (parent->getParent() && parent->getBalance() != 0)
+    {
+        this->insertFix(parent, node);
+    }
+    refreshPath(node);
+}
+
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::insertFix(AVLNode<Key, Value>* node1, AVLNode<Key, Value>* node2)
 {
     if (!node1 || !node1->getParent())
     {
         return;
     }
+    BST_COUNT(insertFixSteps, 1);
 
     AVLNode<Key, Value>* grand = node1->getParent();
     
@@ -340,10 +437,12 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* node1, AVLNode<Key, Val
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>:: remove(const Key& key)
 {
     // TODO
+    BST_COUNT(removes, 1);
+    LatencyTimer timer(this->latency_, OP_REMOVE);
     AVLNode<Key, Value>* toRemove = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
 
     if (!this->root_)
@@ -358,6 +457,31 @@ void AVLTree<Key, Value>:: remove(const Key& key)
         return;
     }
 
+    if (lazyDelete_)
+    {
+        toRemove->setTombstone(true);
+        ++this->tombstones_;
+        refreshPath(toRemove);
+        if (this->tombstones_ >= MIN_AUTO_COMPACT &&
+            this->tombstones_ > compactRatio_ * this->size_)
+        {
+            compact();
+        }
+        return;
+    }
+
+    unlinkNode(toRemove);
+    this->destroyNode(toRemove);
+}
+
+/**
+* Takes node out of the tree's structure and rebalances, without freeing
+* it; remove and extract share it.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::unlinkNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value>* toRemove = static_cast<AVLNode<Key, Value>*>(node);
     if (!toRemove->getLeft() && !toRemove->getRight())
     {
         this->removeZeroAVLChildren(toRemove);
@@ -397,13 +521,163 @@ void AVLTree<Key, Value>:: remove(const Key& key)
     }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int8_t diff)
+/**
+* Hangs a node from another tree of this type off the tree as a new leaf
+* and rebalances, as insert does for a fresh node. A lazily deleted node
+* with the same key is freed first; a live one is returned instead and
+* the node is left out.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* AVLTree<Key, Value, Compare>::linkNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value>* leaf = static_cast<AVLNode<Key, Value>*>(node);
+    AVLNode<Key, Value>* parent = nullptr;
+    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
+    int cmp = 0;
+    while (current)
+    {
+        BST_COUNT(nodeVisits, 1);
+        BST_COUNT(comparisons, 1);
+        cmp = KeyComparator<Compare>::compare(this->compare_, leaf->getKey(), current->getKey());
+        if (cmp == 0)
+        {
+            if (!current->isTombstone())
+            {
+                return current;
+            }
+            --this->tombstones_;
+            unlinkNode(current);
+            this->destroyNode(current);
+            parent = nullptr;
+            current = static_cast<AVLNode<Key, Value>*>(this->root_);
+            continue;
+        }
+        parent = current;
+        current = cmp < 0 ? current->getLeft() : current->getRight();
+    }
+
+    leaf->setParent(parent);
+    leaf->setLeft(nullptr);
+    leaf->setRight(nullptr);
+    leaf->setBalance(0);
+    leaf->setTombstone(false);
+    if (!parent)
+    {
+        this->root_ = leaf;
+        refreshPath(leaf);
+    }
+    else
+    {
+        attachLeaf(parent, leaf, cmp < 0);
+    }
+    return leaf;
+}
+
+/**
+* With lazy deletion enabled, remove only marks the node as a tombstone
+* after the O(log n) search: no node is unlinked and no rotations run.
+* Lookups and iterators skip tombstones and insert revives them in place.
+* By default nothing is compacted until compact() is called, so no single
+* remove pays for an O(n) rebuild; call it at a quiet moment. Automatic
+* compaction is opt-in: with a compactRatio below 1, the remove that
+* makes tombstones more than that fraction of the nodes (and at least
+* MIN_AUTO_COMPACT of them) calls compact() itself, and that remove takes
+* O(n). Disabling lazy deletion compacts right away.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::setLazyDelete(bool enabled, double compactRatio)
+{
+    lazyDelete_ = enabled;
+    compactRatio_ = compactRatio;
+    if (!enabled)
+    {
+        compact();
+    }
+}
+
+/**
+* Frees every tombstone and relinks the remaining nodes into a perfectly
+* balanced tree in O(n), without any per-key rotations. The live nodes
+* are reused, so iterators to them stay valid.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::compact()
+{
+    if (!this->tombstones_)
+    {
+        return;
+    }
+
+    std::vector<AVLNode<Key, Value>*> nodes;
+    nodes.reserve(this->size_);
+    for (Node<Key, Value>* n = this->getSmallestNode(); n; n = this->successor(n))
+    {
+        nodes.push_back(static_cast<AVLNode<Key, Value>*>(n));
+    }
+
+    size_t live = 0;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (nodes[i]->isTombstone())
+        {
+            this->destroyNode(nodes[i]);
+        }
+        else
+        {
+            nodes[live++] = nodes[i];
+        }
+    }
+    this->tombstones_ = 0;
+
+    int height = 0;
+    this->root_ = buildBalanced(nodes, 0, live, nullptr, height);
+    refreshSubtree(static_cast<AVLNode<Key, Value>*>(this->root_));
+}
+
+/**
+* The number of lazily deleted nodes waiting for compact().
+*/
+template<class Key, class Value, class Compare>
+size_t AVLTree<Key, Value, Compare>::tombstones() const
+{
+    return this->tombstones_;
+}
+
+/**
+* Links nodes[first, last) into a balanced subtree under parent and returns
+* its root. The middle node becomes the root, so the two halves differ by
+* at most one node and the resulting balance factors are all valid.
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::buildBalanced(std::vector<AVLNode<Key, Value>*>& nodes,
+                                                        size_t first, size_t last,
+                                                        AVLNode<Key, Value>* parent, int& height)
+{
+    if (first == last)
+    {
+        height = 0;
+        return nullptr;
+    }
+    size_t mid = first + (last - first) / 2;
+    AVLNode<Key, Value>* node = nodes[mid];
+    int leftHeight = 0;
+    int rightHeight = 0;
+    node->setParent(parent);
+    node->setLeft(buildBalanced(nodes, first, mid, node, leftHeight));
+    node->setRight(buildBalanced(nodes, mid + 1, last, node, rightHeight));
+    node->setBalance((int8_t)(rightHeight - leftHeight));
+    height = 1 + std::max(leftHeight, rightHeight);
+    return node;
+}
+
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::removeFix(AVLNode<Key, Value>* node, int8_t diff)
 {
     if (!node)
     {
         return;
     }
+    BST_COUNT(removeFixSteps, 1);
 
     int8_t ndiff = 0;
     if (isLeftAVLChild(node))
@@ -542,8 +816,8 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int8_t diff)
     }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeZeroAVLChildren(AVLNode<Key, Value>* toRemove)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::removeZeroAVLChildren(AVLNode<Key, Value>* toRemove)
 {
     bool isRoot = false;
 
@@ -567,18 +841,17 @@ void AVLTree<Key, Value>::removeZeroAVLChildren(AVLNode<Key, Value>* toRemove)
         }
     }
 
-    delete toRemove;
-
     if (isRoot)
     {
         this->root_ = nullptr;
     }
 
     removeFix(parent, diff);
+    refreshPath(parent);
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeWithLeftAVLChild(AVLNode<Key, Value>* toRemove)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::removeWithLeftAVLChild(AVLNode<Key, Value>* toRemove)
 {
     bool isRoot = false;
     if (toRemove == this->root_)
@@ -593,6 +866,9 @@ void AVLTree<Key, Value>::removeWithLeftAVLChild(AVLNode<Key, Value>* toRemove)
     bool wasLeftChild = isLeftAVLChild(toRemove);
 
     nodeSwap(child, toRemove);
+    // the only child of a one-child AVL node is a leaf, so it keeps a balance
+    // of 0 rather than the one nodeSwap handed it
+    child->setBalance(0);
 
     if (parent)
     {
@@ -621,18 +897,17 @@ void AVLTree<Key, Value>::removeWithLeftAVLChild(AVLNode<Key, Value>* toRemove)
         child->getRight()->setParent(parent);
     }
 
-    delete toRemove;
-
     if (isRoot)
     {
         this->root_ = child;
     }
     
     removeFix(parent, diff);
+    refreshPath(child);
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeWithRightAVLChild(AVLNode<Key, Value>* toRemove)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::removeWithRightAVLChild(AVLNode<Key, Value>* toRemove)
 {
     bool isRoot = false;
     if (toRemove == this->root_)
@@ -646,6 +921,9 @@ void AVLTree<Key, Value>::removeWithRightAVLChild(AVLNode<Key, Value>* toRemove)
     bool wasLeftChild = isLeftAVLChild(toRemove);
 
     nodeSwap(child, toRemove);
+    // the only child of a one-child AVL node is a leaf, so it keeps a balance
+    // of 0 rather than the one nodeSwap handed it
+    child->setBalance(0);
 
     if (parent)
     {
@@ -674,19 +952,18 @@ void AVLTree<Key, Value>::removeWithRightAVLChild(AVLNode<Key, Value>* toRemove)
         child->getRight()->setParent(parent);
     }
 
-    delete toRemove;
-
     if (isRoot)
     {
         this->root_ = child;
     }
     
     removeFix(parent, diff);
+    refreshPath(child);
 }
 
 
-template<class Key, class Value>
-bool AVLTree<Key, Value>::zigZig(const AVLNode<Key, Value>* node) const
+template<class Key, class Value, class Compare>
+bool AVLTree<Key, Value, Compare>::zigZig(const AVLNode<Key, Value>* node) const
 {
     // sees if the current node created a zig-zig condition
     if (!node)
@@ -714,8 +991,8 @@ bool AVLTree<Key, Value>::zigZig(const AVLNode<Key, Value>* node) const
     }
 }
     
-template<class Key, class Value>
-bool AVLTree<Key, Value>::isRightAVLChild(const AVLNode<Key, Value>* current)
+template<class Key, class Value, class Compare>
+bool AVLTree<Key, Value, Compare>::isRightAVLChild(const AVLNode<Key, Value>* current)
 {
     if (!current)
     {
@@ -735,8 +1012,8 @@ bool AVLTree<Key, Value>::isRightAVLChild(const AVLNode<Key, Value>* current)
     }
 }
 
-template<class Key, class Value>
-bool AVLTree<Key, Value>::isLeftAVLChild(const AVLNode<Key, Value>* current)
+template<class Key, class Value, class Compare>
+bool AVLTree<Key, Value, Compare>::isLeftAVLChild(const AVLNode<Key, Value>* current)
 {
     if (!current)
     {
@@ -756,9 +1033,10 @@ bool AVLTree<Key, Value>::isLeftAVLChild(const AVLNode<Key, Value>* current)
     }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::rotateLeft(AVLNode<Key, Value>* node)
 {
+    BST_COUNT(rotateLefts, 1);
     bool isRoot = false;
     if (node == this->root_)
     {
@@ -791,11 +1069,14 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node)
     {
         this->root_ = child;
     }
+    refreshNode(node);
+    refreshNode(child);
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::rotateRight(AVLNode<Key, Value>* node)
 {
+    BST_COUNT(rotateRights, 1);
     bool isRoot = false;
     if (node == this->root_)
     {
@@ -826,12 +1107,51 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node)
     {
         this->root_ = child;
     }
+    refreshNode(node);
+    refreshNode(child);
+}
+
+/**
+* Called for both nodes of every rotation, lower one first. Rotations only
+* move whole subtrees, so a node whose subtree did not otherwise change is
+* correct after this; the others lie on the path passed to refreshPath at
+* the end of the operation.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::refreshNode(AVLNode<Key, Value>*)
+{
 
 }
 
-template<class Key, class Value>
+/**
+* Called once at the end of every insert, overwrite and remove (eager or
+* lazy), with the lowest node whose subtree changed: the new leaf, the
+* updated node, or the removed node's replacement or parent.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::refreshPath(AVLNode<Key, Value>*)
+{
+
+}
+
+/**
+* Refreshes every node of a subtree bottom-up, after compact() relinked it.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::refreshSubtree(AVLNode<Key, Value>* root)
+{
+    if (!root)
+    {
+        return;
+    }
+    refreshSubtree(root->getLeft());
+    refreshSubtree(root->getRight());
+    refreshNode(root);
+}
+
+template<class Key, class Value, class Compare>
 AVLNode<Key, Value>*
-AVLTree<Key, Value>::predecessor(AVLNode<Key, Value>* current)
+AVLTree<Key, Value, Compare>::predecessor(AVLNode<Key, Value>* current)
 {
     // TODO
     AVLNode<Key, Value>* pred = nullptr;
@@ -872,10 +1192,34 @@ AVLTree<Key, Value>::predecessor(AVLNode<Key, Value>* current)
 }
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, class Compare>
+Node<Key, Value>* AVLTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    Node<Key, Value>* node = new AVLNode<Key, Value>(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+    ++this->size_;
+    return node;
+}
+
+template<class Key, class Value, class Compare>
+size_t AVLTree<Key, Value, Compare>::nodeSize() const
+{
+    return sizeof(AVLNode<Key, Value>);
+}
+
+/**
+* Reports the stored balance factor to the exporters.
+*/
+template<class Key, class Value, class Compare>
+bool AVLTree<Key, Value, Compare>::nodeBalance(const Node<Key, Value>* node, int& balance) const
+{
+    balance = static_cast<const AVLNode<Key, Value>*>(node)->getBalance();
+    return true;
+}
+
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
@@ -0,0 +1,48 @@
+#!/bin/sh
+# Runs paged-bench out of core: the process gets a memory limit of MEM_MB
+# (default 256) enforced by a cgroup, which also charges the OS page cache
+# it fills, and the data set is four times that. The buffer pool gets a
+# quarter of the limit.
+#
+#   MEM_MB=512 ./bench-paged.sh [extra paged-bench arguments]
+#
+# The limit comes from systemd-run when a user systemd instance is
+# available, otherwise from a cgroup v2 directory created under the
+# current one (needs write access to it, e.g. as root). Without either the
+# benchmark still runs, but only the buffer pool is limited and reads may
+# be served from the page cache; a warning says so.
+
+set -e
+
+MEM_MB=${MEM_MB:-256}
+DATA_MB=$((MEM_MB * 4))
+POOL_MB=$((MEM_MB / 4))
+FILE=${FILE:-paged-bench.db}
+BENCH="./paged-bench --file $FILE --data-mb $DATA_MB --pool-mb $POOL_MB $*"
+
+if command -v systemd-run >/dev/null 2>&1 &&
+   systemd-run --user --scope --quiet true >/dev/null 2>&1; then
+    echo "# memory limit ${MEM_MB}M via systemd-run, data ${DATA_MB}M" >&2
+    exec systemd-run --user --scope --quiet -p MemoryMax=${MEM_MB}M -p MemorySwapMax=0 $BENCH
+fi
+
+CGROOT=/sys/fs/cgroup
+if [ -f $CGROOT/cgroup.controllers ]; then
+    PARENT=$CGROOT$(sed -n 's/^0:://p' /proc/self/cgroup)
+    GROUP=$PARENT/paged-bench.$$
+    if mkdir "$GROUP" 2>/dev/null; then
+        if echo "${MEM_MB}M" > "$GROUP/memory.max" 2>/dev/null; then
+            echo 0 > "$GROUP/memory.swap.max" 2>/dev/null || true
+            echo "# memory limit ${MEM_MB}M via $GROUP, data ${DATA_MB}M" >&2
+            status=0
+            sh -c "echo \$\$ > $GROUP/cgroup.procs && exec $BENCH" || status=$?
+            rmdir "$GROUP" 2>/dev/null || true
+            exit $status
+        fi
+        rmdir "$GROUP" 2>/dev/null || true
+    fi
+fi
+
+echo "# warning: no cgroup memory limit available; only the buffer pool" \
+     "(${POOL_MB}M) is limited, the page cache is not" >&2
+exec $BENCH
@@ -0,0 +1,834 @@
+// Benchmark harness for the search trees.
+//
+// Every (tree, key order, size) combination runs in its own forked child so
+// that the reported peak RSS belongs to that combination only. Results are
+// printed one line per measured operation, as CSV (default) or JSON lines.
+//
+//   ./bst-bench --sizes 1000,100000 --trees avl,map --orders random,zipf
+//               --ops insert,find,iterate,mixed,remove --format json
+//
+// With --latency every insert/find/mixed/remove call is timed individually
+// and the p50/p99/p99.9/max latencies are reported next to the throughput.
+// The per-call clock reads add some overhead to the throughput numbers.
+//
+// --keys url runs the same orders on URL-like string keys instead of
+// 64-bit integers (see makeUrlKeys); prefix-avl, the AVL tree with inline
+// key prefixes, needs them.
+//
+// avl-cached puts a small lookup cache in front of find, which pays off on
+// the skewed zipf order. avl-indexed is the AVL tree with a hash index over its nodes, for
+// workloads dominated by point lookups. avl-rcu is the copy-on-write AVL
+// tree with lock-free readers; each find takes a ReadGuard.
+//
+// The pscan op updates every value with BinarySearchTree::parallelForEach on
+// --threads threads (default: one per hardware thread); trees without a
+// parallel scan skip it.
+//
+// Heap allocations are always counted (see alloc_counter.h) and reported as
+// allocs_per_op, so allocation-free paths such as find and iteration can
+// be checked from the output.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "bst.h"
+#include "avlbst.h"
+#include "compact_avlbst.h"
+#include "prefix_avlbst.h"
+#include "indexed_avlbst.h"
+#include "rcu_avlbst.h"
+#include "bst_latency.h"
+#include "alloc_counter.h"
+
+using namespace std;
+
+typedef uint64_t BenchKey;
+typedef uint64_t BenchValue;
+typedef string UrlKey;
+
+struct BenchConfig
+{
+    vector<size_t> sizes;
+    vector<string> trees;
+    vector<string> orders;
+    vector<string> ops;
+    string keys;
+    string format;
+    // unbalanced BSTs are quadratic on sequential/adversarial orders
+    size_t bstDegenerateCap;
+    uint64_t seed;
+    bool latency;
+    unsigned threads;
+};
+
+struct BenchResult
+{
+    string op;
+    size_t count;
+    double seconds;
+    uint64_t checksum;
+    uint64_t allocations;
+    bool hasLatency;
+    LatencyHistogram latency;
+};
+
+/*
+  ------------------------------------
+  Key order generation
+  ------------------------------------
+*/
+
+// Spreads 0..n-1 over the 64-bit key space without collisions, so random
+// orders do not accidentally look sequential to the tree.
+static BenchKey scramble(uint64_t rank)
+{
+    return rank * 0x9E3779B97F4A7C15ULL;
+}
+
+/**
+* Zipfian rank generator (Gray et al., "Quickly generating billion-record
+* synthetic databases"), as used by YCSB. Rank 0 is the hottest.
+*/
+class ZipfGenerator
+{
+public:
+    ZipfGenerator(uint64_t n, double theta, uint64_t seed) :
+        n_(n), theta_(theta), rng_(seed), uniform_(0.0, 1.0)
+    {
+        zetan_ = zeta(n, theta);
+        double zeta2 = zeta(2, theta);
+        alpha_ = 1.0 / (1.0 - theta);
+        eta_ = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan_);
+    }
+
+    uint64_t next()
+    {
+        double u = uniform_(rng_);
+        double uz = u * zetan_;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta_)) return 1;
+        uint64_t rank = (uint64_t)(n_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return rank < n_ ? rank : n_ - 1;
+    }
+
+private:
+    static double zeta(uint64_t n, double theta)
+    {
+        double sum = 0;
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            sum += 1.0 / std::pow((double)(i + 1), theta);
+        }
+        return sum;
+    }
+
+    uint64_t n_;
+    double theta_;
+    double zetan_;
+    double alpha_;
+    double eta_;
+    mt19937_64 rng_;
+    uniform_real_distribution<double> uniform_;
+};
+
+/**
+* Returns n key ranks in [0, n) in the requested order:
+*   seq         - ascending
+*   random      - a uniform random permutation
+*   zipf        - n Zipf(0.99) draws over n keys, so hot keys repeat
+*   adversarial - alternating smallest/largest remaining key, which builds
+*                 a zig-zag chain in an unbalanced tree and forces double
+*                 rotations in a balanced one
+*/
+static vector<uint64_t> makeRanks(const string& order, size_t n, uint64_t seed)
+{
+    vector<uint64_t> ranks;
+    ranks.reserve(n);
+    if (order == "seq")
+    {
+        for (size_t i = 0; i < n; ++i) ranks.push_back(i);
+    }
+    else if (order == "random")
+    {
+        for (size_t i = 0; i < n; ++i) ranks.push_back(i);
+        mt19937_64 rng(seed);
+        shuffle(ranks.begin(), ranks.end(), rng);
+    }
+    else if (order == "zipf")
+    {
+        ZipfGenerator zipf(n, 0.99, seed);
+        for (size_t i = 0; i < n; ++i) ranks.push_back(zipf.next());
+    }
+    else if (order == "adversarial")
+    {
+        size_t lo = 0, hi = n;
+        while (lo < hi)
+        {
+            ranks.push_back(lo++);
+            if (lo < hi) ranks.push_back(--hi);
+        }
+    }
+    else
+    {
+        cerr << "unknown order: " << order << endl;
+        exit(2);
+    }
+    return ranks;
+}
+
+/**
+* Returns n integer keys in the requested order. Random and zipf ranks are
+* scrambled so the keys do not cluster.
+*/
+static vector<BenchKey> makeKeys(const string& order, size_t n, uint64_t seed)
+{
+    vector<BenchKey> keys = makeRanks(order, n, seed);
+    if (order == "random" || order == "zipf")
+    {
+        for (size_t i = 0; i < keys.size(); ++i) keys[i] = scramble(keys[i]);
+    }
+    return keys;
+}
+
+/**
+* A URL-like key, unique per id: a scheme, one of a few hundred hosts and
+* a two-level path, so many keys share long prefixes.
+*/
+static UrlKey urlFor(uint64_t id)
+{
+    static const char* const words[] = {
+        "news", "shop", "mail", "blog", "docs", "cloud", "media", "games",
+        "search", "maps", "video", "music", "photos", "sports", "travel", "weather"
+    };
+    static const char* const tlds[] = { ".com", ".org", ".net", ".io" };
+    uint64_t h = scramble(id + 1);
+    ostringstream url;
+    url << "https://" << ((h & 1) ? "www." : "")
+        << words[(h >> 1) % 16] << words[(h >> 5) % 16] << tlds[(h >> 9) % 4]
+        << "/" << words[(h >> 11) % 16] << "/item-" << id;
+    return url.str();
+}
+
+/**
+* Returns n URL keys in the requested order: the ranks of makeRanks index
+* the sorted list of urlFor(0..n-1), so seq and adversarial keep their
+* meaning. Zipf ranks are scrambled so the hot keys are spread out.
+*/
+static vector<UrlKey> makeUrlKeys(const string& order, size_t n, uint64_t seed)
+{
+    vector<UrlKey> sorted;
+    sorted.reserve(n);
+    for (size_t i = 0; i < n; ++i) sorted.push_back(urlFor(i));
+    sort(sorted.begin(), sorted.end());
+
+    vector<uint64_t> ranks = makeRanks(order, n, seed);
+    vector<UrlKey> keys;
+    keys.reserve(n);
+    for (size_t i = 0; i < ranks.size(); ++i)
+    {
+        uint64_t rank = order == "zipf" ? scramble(ranks[i]) % n : ranks[i];
+        keys.push_back(sorted[rank]);
+    }
+    return keys;
+}
+
+/*
+  ------------------------------------
+  Tree adapters
+  ------------------------------------
+*/
+
+// An AVL tree with lazy deletion on, benchmarked as "avl-lazy".
+template<typename Key, typename Value>
+class LazyAVLTree : public AVLTree<Key, Value>
+{
+public:
+    LazyAVLTree()
+    {
+        this->setLazyDelete(true);
+    }
+};
+
+// An AVL tree with a 256-slot lookup cache, benchmarked as "avl-cached".
+template<typename Key, typename Value>
+class CachedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    CachedAVLTree()
+    {
+        this->enableLookupCache(256);
+    }
+};
+
+// Folds a key into the iteration checksum.
+static inline uint64_t keyChecksum(BenchKey k) { return k; }
+static inline uint64_t keyChecksum(const UrlKey& k) { return k.size(); }
+
+template<typename Tree>
+struct TreeOps
+{
+    template<typename Key>
+    static void insert(Tree& t, const Key& k, BenchValue v) { t.insert(make_pair(k, v)); }
+    template<typename Key>
+    static bool find(const Tree& t, const Key& k, uint64_t& sum)
+    {
+        typename Tree::iterator it = t.find(k);
+        if (it == t.end()) return false;
+        sum += it->second;
+        return true;
+    }
+    template<typename Key>
+    static void remove(Tree& t, const Key& k) { t.remove(k); }
+    static uint64_t iterate(const Tree& t, size_t& count)
+    {
+        uint64_t sum = 0;
+        if (t.empty()) return sum;
+        for (typename Tree::iterator it = t.begin(); it != t.end(); ++it)
+        {
+            sum += keyChecksum(it->first);
+            ++count;
+        }
+        return sum;
+    }
+};
+
+template<typename Key>
+struct TreeOps<map<Key, BenchValue> >
+{
+    typedef map<Key, BenchValue> Tree;
+    static void insert(Tree& t, const Key& k, BenchValue v) { t[k] = v; }
+    static bool find(const Tree& t, const Key& k, uint64_t& sum)
+    {
+        typename Tree::const_iterator it = t.find(k);
+        if (it == t.end()) return false;
+        sum += it->second;
+        return true;
+    }
+    static void remove(Tree& t, const Key& k) { t.erase(k); }
+    static uint64_t iterate(const Tree& t, size_t& count)
+    {
+        uint64_t sum = 0;
+        for (typename Tree::const_iterator it = t.begin(); it != t.end(); ++it)
+        {
+            sum += keyChecksum(it->first);
+            ++count;
+        }
+        return sum;
+    }
+};
+
+// Readers of the RCU tree run under a ReadGuard: one per find, as a reader
+// thread doing point lookups would, and one for a whole iteration.
+template<typename Key>
+struct TreeOps<RcuAVLTree<Key, BenchValue> >
+{
+    typedef RcuAVLTree<Key, BenchValue> Tree;
+    static void insert(Tree& t, const Key& k, BenchValue v) { t.insert(make_pair(k, v)); }
+    static bool find(const Tree& t, const Key& k, uint64_t& sum)
+    {
+        typename Tree::ReadGuard guard(t);
+        typename Tree::iterator it = t.find(k);
+        if (it == t.end()) return false;
+        sum += it->second;
+        return true;
+    }
+    static void remove(Tree& t, const Key& k) { t.remove(k); }
+    static uint64_t iterate(const Tree& t, size_t& count)
+    {
+        typename Tree::ReadGuard guard(t);
+        uint64_t sum = 0;
+        for (typename Tree::iterator it = t.begin(); it != t.end(); ++it)
+        {
+            sum += keyChecksum(it->first);
+            ++count;
+        }
+        return sum;
+    }
+};
+
+// Scrambles one value; the per-item work of the pscan op.
+static inline BenchValue scanMix(BenchValue v)
+{
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    return v;
+}
+
+struct ScanMixFn
+{
+    template<typename Item>
+    void operator()(Item& item) const
+    {
+        item.second = scanMix(item.second);
+    }
+};
+
+// Parallel in-place value update; false if the tree has no parallel scan.
+template<typename Key, typename Value>
+bool parallelScan(const BinarySearchTree<Key, Value>& t, unsigned threads)
+{
+    t.parallelForEach(ScanMixFn(), threads);
+    return true;
+}
+
+template<typename Key, typename Value>
+bool parallelScan(const CompactAVLTree<Key, Value>&, unsigned)
+{
+    return false;
+}
+
+template<typename Key, typename Value>
+bool parallelScan(const RcuAVLTree<Key, Value>&, unsigned)
+{
+    return false;
+}
+
+template<typename Key, typename Value>
+bool parallelScan(const map<Key, Value>&, unsigned)
+{
+    return false;
+}
+
+/*
+  ------------------------------------
+  Measurement
+  ------------------------------------
+*/
+
+typedef chrono::steady_clock BenchClock;
+
+static double secondsSince(BenchClock::time_point start)
+{
+    return chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+// Runs stmt, timing it into the histogram hist when hist is not NULL.
+#define BENCH_TIMED(hist, stmt)                                                     \
+    do                                                                              \
+    {                                                                               \
+        if (hist)                                                                   \
+        {                                                                           \
+            BenchClock::time_point t0 = BenchClock::now();                          \
+            stmt;                                                                   \
+            (hist)->record(chrono::duration_cast<chrono::nanoseconds>(             \
+                BenchClock::now() - t0).count());                                   \
+        }                                                                           \
+        else                                                                        \
+        {                                                                           \
+            stmt;                                                                   \
+        }                                                                           \
+    } while (0)
+
+static BenchResult makeResult(const string& op, size_t count, double seconds, uint64_t checksum)
+{
+    BenchResult r;
+    r.op = op;
+    r.count = count;
+    r.seconds = seconds;
+    r.checksum = checksum;
+    r.allocations = 0;
+    r.hasLatency = false;
+    return r;
+}
+
+// Records the allocations made since scope started and moves the latencies
+// collected for the last phase into its result.
+static void finishPhase(vector<BenchResult>& results, const AllocScope& scope, LatencyHistogram* hist)
+{
+    results.back().allocations = scope.allocations();
+    if (hist)
+    {
+        results.back().hasLatency = true;
+        results.back().latency = *hist;
+        hist->reset();
+    }
+}
+
+static long peakRssKb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static bool wants(const vector<string>& list, const string& item)
+{
+    return find(list.begin(), list.end(), item) != list.end();
+}
+
+/**
+* Runs the requested operations on one tree type for one key sequence.
+* The tree is always populated first (insert), since every other operation
+* needs a full tree; insert is only reported if it was requested.
+*/
+template<typename Tree, typename Key>
+vector<BenchResult> runTree(const BenchConfig& cfg, const vector<Key>& keys)
+{
+    typedef TreeOps<Tree> Ops;
+    vector<BenchResult> results;
+    Tree tree;
+    uint64_t sum = 0;
+    LatencyHistogram hist;
+    LatencyHistogram* h = cfg.latency ? &hist : NULL;
+
+    AllocScope scope;
+    BenchClock::time_point start = BenchClock::now();
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        BENCH_TIMED(h, Ops::insert(tree, keys[i], i));
+    }
+    results.push_back(makeResult("insert", keys.size(), secondsSince(start), 0));
+    finishPhase(results, scope, h);
+    if (!wants(cfg.ops, "insert")) results.pop_back();
+
+    if (wants(cfg.ops, "find"))
+    {
+        scope = AllocScope();
+        start = BenchClock::now();
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            BENCH_TIMED(h, Ops::find(tree, keys[i], sum));
+        }
+        results.push_back(makeResult("find", keys.size(), secondsSince(start), sum));
+        finishPhase(results, scope, h);
+    }
+
+    if (wants(cfg.ops, "iterate"))
+    {
+        size_t count = 0;
+        scope = AllocScope();
+        start = BenchClock::now();
+        sum = Ops::iterate(tree, count);
+        results.push_back(makeResult("iterate", count, secondsSince(start), sum));
+        finishPhase(results, scope, NULL);
+    }
+
+    if (wants(cfg.ops, "pscan"))
+    {
+        scope = AllocScope();
+        start = BenchClock::now();
+        if (parallelScan(tree, cfg.threads))
+        {
+            double seconds = secondsSince(start);
+            size_t count = 0;
+            results.push_back(makeResult("pscan", tree.size(), seconds, Ops::iterate(tree, count)));
+            finishPhase(results, scope, NULL);
+        }
+    }
+
+    if (wants(cfg.ops, "mixed"))
+    {
+        // 50% find, 25% insert/update, 25% remove, over the same key sequence
+        mt19937_64 rng(cfg.seed + 1);
+        scope = AllocScope();
+        start = BenchClock::now();
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            const Key& k = keys[rng() % keys.size()];
+            switch (rng() & 3)
+            {
+            case 0:
+            case 1:
+                BENCH_TIMED(h, Ops::find(tree, k, sum));
+                break;
+            case 2:
+                BENCH_TIMED(h, Ops::insert(tree, k, i));
+                break;
+            default:
+                BENCH_TIMED(h, Ops::remove(tree, k));
+                break;
+            }
+        }
+        results.push_back(makeResult("mixed", keys.size(), secondsSince(start), sum));
+        finishPhase(results, scope, h);
+    }
+
+    if (wants(cfg.ops, "remove"))
+    {
+        scope = AllocScope();
+        start = BenchClock::now();
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            BENCH_TIMED(h, Ops::remove(tree, keys[i]));
+        }
+        results.push_back(makeResult("remove", keys.size(), secondsSince(start), 0));
+        finishPhase(results, scope, h);
+    }
+
+    return results;
+}
+
+static void printHeader(const BenchConfig& cfg)
+{
+    if (cfg.format == "csv")
+    {
+        cout << "tree,keys,order,size,op,count,seconds,ns_per_op,ops_per_sec,peak_rss_kb,checksum,"
+             << "allocs_per_op,p50_ns,p99_ns,p999_ns,max_ns" << endl;
+    }
+}
+
+static void printResult(const BenchConfig& cfg, const string& tree, const string& order,
+                        size_t size, const BenchResult& r, long rssKb)
+{
+    double nsPerOp = r.count ? r.seconds * 1e9 / r.count : 0.0;
+    double opsPerSec = r.seconds > 0 ? r.count / r.seconds : 0.0;
+    double allocsPerOp = r.count ? (double)r.allocations / r.count : 0.0;
+    ostringstream secs;
+    secs.setf(ios::fixed);
+    secs.precision(6);
+    secs << r.seconds;
+    ostringstream line;
+    line.setf(ios::fixed);
+    line.precision(2);
+    if (cfg.format == "json")
+    {
+        line << "{\"tree\":\"" << tree << "\",\"keys\":\"" << cfg.keys << "\",\"order\":\"" << order << "\",\"size\":" << size
+             << ",\"op\":\"" << r.op << "\",\"count\":" << r.count
+             << ",\"seconds\":" << secs.str() << ",\"ns_per_op\":" << nsPerOp
+             << ",\"ops_per_sec\":" << opsPerSec << ",\"peak_rss_kb\":" << rssKb
+             << ",\"checksum\":" << r.checksum << ",\"allocs_per_op\":" << allocsPerOp;
+        if (r.hasLatency)
+        {
+            line << ",\"p50_ns\":" << r.latency.percentile(0.50)
+                 << ",\"p99_ns\":" << r.latency.percentile(0.99)
+                 << ",\"p999_ns\":" << r.latency.percentile(0.999)
+                 << ",\"max_ns\":" << r.latency.max();
+        }
+        line << "}";
+    }
+    else
+    {
+        line << tree << ',' << cfg.keys << ',' << order << ',' << size << ',' << r.op << ',' << r.count << ','
+             << secs.str() << ',' << nsPerOp << ',' << opsPerSec << ',' << rssKb << ','
+             << r.checksum << ',' << allocsPerOp << ',';
+        if (r.hasLatency)
+        {
+            line << r.latency.percentile(0.50) << ',' << r.latency.percentile(0.99) << ','
+                 << r.latency.percentile(0.999) << ',' << r.latency.max();
+        }
+        else
+        {
+            line << ",,,";
+        }
+    }
+    // one write per line so output from sequential children never interleaves
+    cout << line.str() << endl;
+}
+
+// prefix-avl caches key bytes, so it only makes sense for string keys.
+static vector<BenchResult> runPrefixTree(const BenchConfig& cfg, const vector<UrlKey>& keys)
+{
+    return runTree<PrefixAVLTree<UrlKey, BenchValue> >(cfg, keys);
+}
+
+static vector<BenchResult> runPrefixTree(const BenchConfig&, const vector<BenchKey>&)
+{
+    cerr << "prefix-avl needs --keys url" << endl;
+    exit(2);
+}
+
+template<typename Key>
+vector<BenchResult> runTrees(const BenchConfig& cfg, const string& tree, const vector<Key>& keys)
+{
+    if (tree == "bst")
+    {
+        return runTree<BinarySearchTree<Key, BenchValue> >(cfg, keys);
+    }
+    else if (tree == "avl")
+    {
+        return runTree<AVLTree<Key, BenchValue> >(cfg, keys);
+    }
+    else if (tree == "avl-lazy")
+    {
+        return runTree<LazyAVLTree<Key, BenchValue> >(cfg, keys);
+    }
+    else if (tree == "avl-cached")
+    {
+        return runTree<CachedAVLTree<Key, BenchValue> >(cfg, keys);
+    }
+    else if (tree == "avl-indexed")
+    {
+        return runTree<IndexedAVLTree<Key, BenchValue> >(cfg, keys);
+    }
+    else if (tree == "avl-rcu")
+    {
+        return runTree<RcuAVLTree<Key, BenchValue> >(cfg, keys);
+    }
+    else if (tree == "prefix-avl")
+    {
+        return runPrefixTree(cfg, keys);
+    }
+    else if (tree == "compact")
+    {
+        return runTree<CompactAVLTree<Key, BenchValue> >(cfg, keys);
+    }
+    else if (tree == "map")
+    {
+        return runTree<map<Key, BenchValue> >(cfg, keys);
+    }
+    cerr << "unknown tree: " << tree << endl;
+    exit(2);
+}
+
+static void runOne(const BenchConfig& cfg, const string& tree, const string& order, size_t size)
+{
+    vector<BenchResult> results;
+    if (cfg.keys == "url")
+    {
+        results = runTrees(cfg, tree, makeUrlKeys(order, size, cfg.seed));
+    }
+    else
+    {
+        results = runTrees(cfg, tree, makeKeys(order, size, cfg.seed));
+    }
+
+    long rss = peakRssKb();
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        printResult(cfg, tree, order, size, results[i], rss);
+    }
+}
+
+/*
+  ------------------------------------
+  Command line
+  ------------------------------------
+*/
+
+static vector<string> splitList(const string& s)
+{
+    vector<string> items;
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, ','))
+    {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+static void usage(const char* prog)
+{
+    cerr << "usage: " << prog << " [--sizes N,...] [--trees bst,avl,avl-lazy,avl-cached,avl-indexed,avl-rcu,prefix-avl,compact,map]\n"
+         << "       [--orders seq,random,zipf,adversarial] [--keys int|url]\n"
+         << "       [--ops insert,find,iterate,pscan,mixed,remove] [--format csv|json]\n"
+         << "       [--bst-cap N] [--seed N] [--threads N] [--latency]" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig cfg;
+    cfg.sizes.push_back(1000);
+    cfg.sizes.push_back(10000);
+    cfg.sizes.push_back(100000);
+    cfg.sizes.push_back(1000000);
+    cfg.trees = splitList("bst,avl,compact,map");
+    cfg.orders = splitList("seq,random,zipf,adversarial");
+    cfg.ops = splitList("insert,find,iterate,mixed,remove");
+    cfg.keys = "int";
+    cfg.format = "csv";
+    cfg.bstDegenerateCap = 20000;
+    cfg.seed = 42;
+    cfg.latency = false;
+    cfg.threads = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--latency")
+        {
+            cfg.latency = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        string val = argv[++i];
+        if (arg == "--sizes")
+        {
+            cfg.sizes.clear();
+            vector<string> sizes = splitList(val);
+            for (size_t j = 0; j < sizes.size(); ++j)
+            {
+                cfg.sizes.push_back(strtoull(sizes[j].c_str(), NULL, 10));
+            }
+        }
+        else if (arg == "--trees") cfg.trees = splitList(val);
+        else if (arg == "--orders") cfg.orders = splitList(val);
+        else if (arg == "--ops") cfg.ops = splitList(val);
+        else if (arg == "--keys") cfg.keys = val;
+        else if (arg == "--format") cfg.format = val;
+        else if (arg == "--bst-cap") cfg.bstDegenerateCap = strtoull(val.c_str(), NULL, 10);
+        else if (arg == "--seed") cfg.seed = strtoull(val.c_str(), NULL, 10);
+        else if (arg == "--threads") cfg.threads = (unsigned)strtoul(val.c_str(), NULL, 10);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (cfg.keys != "int" && cfg.keys != "url")
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printHeader(cfg);
+    for (size_t s = 0; s < cfg.sizes.size(); ++s)
+    {
+        for (size_t o = 0; o < cfg.orders.size(); ++o)
+        {
+            for (size_t t = 0; t < cfg.trees.size(); ++t)
+            {
+                const string& tree = cfg.trees[t];
+                const string& order = cfg.orders[o];
+                size_t size = cfg.sizes[s];
+                if (tree == "bst" && (order == "seq" || order == "adversarial") &&
+                    size > cfg.bstDegenerateCap)
+                {
+                    cerr << "skipping bst/" << order << "/" << size
+                         << " (degenerate, above --bst-cap)" << endl;
+                    continue;
+                }
+
+                cout.flush();
+                pid_t pid = fork();
+                if (pid < 0)
+                {
+                    perror("fork");
+                    return 1;
+                }
+                if (pid == 0)
+                {
+                    runOne(cfg, tree, order, size);
+                    cout.flush();
+                    _exit(0);
+                }
+                int status = 0;
+                waitpid(pid, &status, 0);
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                {
+                    cerr << tree << "/" << order << "/" << size << " failed" << endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -1,10 +1,45 @@
 #include <iostream>
+#include <cstdio>
 #include <map>
+#include <string>
+#include <string_view>
 #include "bst.h"
 #include "avlbst.h"
+#include "compact_avlbst.h"
+#include "dense_map.h"
+#include "prefix_avlbst.h"
+#include "indexed_avlbst.h"
+#include "update_pipeline.h"
+#include "sharded_avlbst.h"
+#include "rcu_avlbst.h"
+#include "augmented_avlbst.h"
+#include "interval_avlbst.h"
+#include "multimap_avlbst.h"
+#include "paged_bst.h"
+#include "frozen_map.h"
+#include "leaf_depth_avlbst.h"
+#include "alloc_counter.h"
 
 using namespace std;
 
+void truncateValue(std::pair<const int, std::string>& item)
+{
+    item.second.resize(3);
+}
+
+// A large value kept out of the tree nodes
+struct Record
+{
+    int id;
+    char payload[500];
+};
+
+template <> struct ColdValue<Record> { static const bool outOfLine = true; };
+
+std::ostream& operator<<(std::ostream& os, const Record& r)
+{
+    return os << r.id;
+}
 
 int main(int argc, char *argv[])
 {
@@ -43,6 +78,272 @@ int main(int argc, char *argv[])
     }
     cout << "Erasing b" << endl;
     at.remove('b');
+    // all zero unless built with DEFS=-DBST_STATS
+    cout << "AVLTree stats: " << at.stats() << endl;
+
+    at.enableLatencyTracking();
+    at.insert(std::make_pair('c',3));
+    at.find('c');
+    cout << "Timed finds: " << at.latency(OP_FIND)->count() << endl;
+
+    cout << "AVLTree as JSON:" << endl;
+    at.exportJson(cout);
+
+    // Parent-pointer-free AVL Tree Tests
+    CompactAVLTree<char,int> ct;
+    ct.insert(std::make_pair('a',1));
+    ct.insert(std::make_pair('b',2));
+    ct.insert(std::make_pair('c',3));
+
+    cout << "\nCompactAVLTree contents:" << endl;
+    for(CompactAVLTree<char,int>::iterator it = ct.begin(); it != ct.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    cout << "Erasing b" << endl;
+    ct.remove('b');
+    cout << "Balanced: " << ct.isBalanced() << endl;
+
+    // Small integral keys get the direct-indexed map
+    OrderedMap<char,int> dm;
+    dm.insert(std::make_pair('b', 2));
+    dm.insert(std::make_pair('a', 1));
+    dm.insert(std::make_pair('c', 3));
+    dm.remove('b');
+    cout << "\nDenseKeyMap contents:" << endl;
+    for(OrderedMap<char,int>::iterator it = dm.begin(); it != dm.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // String keys with cached prefixes
+    PrefixAVLTree<std::string,int> pt;
+    pt.insert(std::make_pair(std::string("https://example.com/b"), 2));
+    pt.insert(std::make_pair(std::string("https://example.com/a"), 1));
+    pt.insert(std::make_pair(std::string("https://example.org/"), 3));
+    pt.remove("https://example.com/b");
+    cout << "\nPrefixAVLTree contents:" << endl;
+    for(PrefixAVLTree<std::string,int>::iterator it = pt.begin(); it != pt.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Hash-indexed point lookups
+    IndexedAVLTree<int,int> it2;
+    for(int i = 0; i < 100; ++i) {
+        it2.insert(std::make_pair(i, i * i));
+    }
+    it2.insert(std::make_pair(7, -7));
+    it2.remove(50);
+    cout << "\nIndexedAVLTree size " << it2.size() << ", [7] = " << it2[7]
+         << ", 50 found: " << (it2.find(50) != it2.end())
+         << ", balanced: " << it2.isBalanced() << endl;
+
+    // Lookup cache in front of operator[]
+    it2.enableLookupCache(16);
+    for(int i = 0; i < 10; ++i) {
+        it2[7] += 1;
+    }
+    it2.remove(7);
+    cout << "Cache after 10 lookups of 7: " << it2.lookupCacheStats()
+         << ", 7 found after remove: " << (it2.find(7) != it2.end()) << endl;
+
+    // Updates from several threads through one writer
+    {
+        UpdatePipeline<int,int> pipeline;
+        std::thread producers[2];
+        for(int t = 0; t < 2; ++t) {
+            producers[t] = std::thread([&pipeline, t] {
+                for(int i = 0; i < 100; ++i) {
+                    pipeline.insert(t * 1000 + i, i);
+                }
+                pipeline.remove(t * 1000).wait();
+            });
+        }
+        for(int t = 0; t < 2; ++t) {
+            producers[t].join();
+        }
+        pipeline.sync();
+        size_t piped = pipeline.read([](const AVLTree<int,int>& t) { return t.size(); });
+        cout << "Pipeline applied " << pipeline.stats().updates << " updates, tree size " << piped << endl;
+    }
+
+    // Range-sharded tree
+    {
+        ShardedAVLTree<int,int> sharded(std::vector<int>(1, 10));
+        for(int i = 0; i < 40; ++i) {
+            sharded.insert(std::make_pair(i, i));
+        }
+        sharded.rebalance();
+        cout << "Shards after rebalance: " << sharded.shardSize(0) << " " << sharded.shardSize(1)
+             << ", boundary " << sharded.boundaries()[0] << ", first key " << sharded.begin()->first << endl;
+    }
+
+    // Lock-free readers over copy-on-write versions
+    {
+        RcuAVLTree<int,int> rt;
+        for(int i = 0; i < 20; ++i) {
+            rt.insert(std::make_pair(i, i));
+        }
+        RcuAVLTree<int,int>::ReadGuard guard(rt);
+        RcuAVLTree<int,int>::iterator snapshot = rt.find(10);
+        rt.remove(10);
+        rt.insert(std::make_pair(11, 110));
+        cout << "RCU snapshot still has " << snapshot->first << " -> " << (++snapshot)->second
+             << ", current tree has 10: " << (rt.find(10) != rt.end())
+             << ", retired nodes " << rt.retiredNodes() << endl;
+    }
+
+    // Range sums from subtree summaries
+    AugmentedAVLTree<int,int,SumMonoid<int> > sums;
+    for(int i = 1; i <= 100; ++i) {
+        sums.insert(std::make_pair(i, i));
+    }
+    sums.insert(std::make_pair(50, 0));
+    sums.remove(10);
+    cout << "\nSum of all: " << sums.aggregate() << ", sum of [1, 51): " << sums.aggregate(1, 51) << endl;
+
+    // Overlap queries over time ranges
+    IntervalTree<int,std::string> meetings;
+    meetings.insert(std::make_pair(Interval<int>(9, 10), std::string("standup")));
+    meetings.insert(std::make_pair(Interval<int>(9, 17), std::string("on call")));
+    meetings.insert(std::make_pair(Interval<int>(13, 14), std::string("review")));
+    meetings.insert(std::make_pair(Interval<int>(16, 18), std::string("demo")));
+    cout << "\nOverlapping [12, 16]:";
+    for(const auto& meeting : meetings.overlapping(12, 16)) {
+        cout << " " << meeting.first << " " << meeting.second;
+    }
+    cout << "\nAt 10:";
+    for(const auto& meeting : meetings.stabbing(10)) {
+        cout << " " << meeting.first << " " << meeting.second;
+    }
+    cout << endl;
+
+    // Duplicate keys share one node
+    AVLMultiMap<std::string,int> tags;
+    for(int i = 0; i < 5; i++) {
+        tags.insert(std::make_pair(std::string(i % 2 ? "odd" : "even"), i));
+    }
+    tags.erase_one("even");
+    cout << "\nMultimap " << tags.size() << " values over " << tags.keys() << " keys:";
+    for(AVLMultiMap<std::string,int>::iterator it = tags.begin(); it != tags.end(); ++it) {
+        cout << " " << it.key() << "=" << it.value();
+    }
+    cout << "\nCount of odd: " << tags.count("odd") << endl;
+
+    // tryInsert leaves an existing value alone
+    AVLTree<int,int> once;
+    once.insert(std::make_pair(1, 10));
+    bool added = once.tryInsert(std::make_pair(1, 20)).second;
+    cout << "tryInsert on an existing key: " << (added ? "added, " : "kept, ") << once[1] << endl;
+
+    // A map in a file, larger than its buffer pool
+    {
+        PagedBTree<int,double> paged("bst-test-paged.db", 8);
+        paged.clear();
+        for(int i = 0; i < 5000; i++) {
+            paged.insert(std::make_pair(i, i * 0.5));
+        }
+        paged.remove(10);
+        double half = 0;
+        bool found = paged.find(4000, half);
+        cout << "\nPaged map: " << paged.size() << " items, height " << paged.height()
+             << ", " << paged.pages() << " pages; 4000 -> " << (found ? half : -1) << endl;
+        cout << "Buffer pool: " << paged.pagerStats() << endl;
+    }
+    std::remove("bst-test-paged.db");
+
+    // A compressed read-only copy of an integer-keyed tree
+    AVLTree<uint64_t,uint64_t> ids;
+    for(uint64_t i = 0; i < 10000; i++) {
+        ids.insert(std::make_pair(1000000 + 7 * i, i));
+    }
+    FrozenIntMap<uint64_t,uint64_t> frozen(ids);
+    cout << "\nFrozen " << frozen.size() << " items: " << frozen.memoryUsage().total() << " bytes vs "
+         << ids.memoryUsage().total() << "; lower_bound(1000050) -> "
+         << frozen.lower_bound(1000050).key() << ", find(1000049) -> " << frozen.find(1000049).value() << endl;
+
+    // Equal leaf depths answered from the root
+    LeafDepthAVLTree<int,int> shape;
+    for(int i = 1; i <= 7; i++) {
+        shape.insert(std::make_pair(i, i));
+    }
+    cout << "\n7 keys: equal paths " << shape.equalPaths() << ", leaf depths "
+         << shape.minLeafDepth() << ".." << shape.maxLeafDepth() << endl;
+    shape.insert(std::make_pair(8, 8));
+    cout << "8 keys: equal paths " << shape.equalPaths() << ", spread " << shape.leafDepthSpread() << endl;
+
+    // Large values stored out of line
+    AVLTree<int,Record> records;
+    records.setLazyDelete(true);
+    for(int i = 0; i < 100; i++) {
+        Record r = {i * 10, ""};
+        records.insert(std::make_pair(i, r));
+    }
+    records.remove(42);
+    records.compact();
+    AVLTree<int,Record>::iterator rec = records.find(43);
+    rec->second.payload[0] = 'x';
+    cout << "\nRecords: " << records.size() << ", 43 -> " << rec->second.id << rec->second.payload
+         << ", nodes of " << records.memoryUsage().nodeBytes / records.memoryUsage().nodes << " bytes" << endl;
+
+    // Moving nodes between trees without copying their items
+    AVLTree<int,std::string> inbox, archive;
+    for(int i = 1; i <= 6; i++) {
+        inbox.insert(std::make_pair(i, std::string(i, '*')));
+    }
+    archive.insert(std::make_pair(5, std::string("old")));
+    AVLTree<int,std::string>::node_type moved = inbox.extract(2);
+    moved.mapped() += "!";
+    archive.insert(std::move(moved));
+    archive.insert(inbox.extract(inbox.find(3)));
+    archive.merge(inbox);
+    cout << "\nArchive:";
+    for(AVLTree<int,std::string>::iterator it = archive.begin(); it != archive.end(); ++it) {
+        cout << " " << it->first << "=" << it->second;
+    }
+    cout << "\nLeft in inbox: " << inbox.size() << " (key " << inbox.begin()->first << ")" << endl;
+
+    // Transparent comparator: look up string keys by string_view
+    AVLTree<std::string,int,std::less<> > vt;
+    vt.insert(std::make_pair(std::string("apple"), 1));
+    vt.insert(std::make_pair(std::string("banana"), 2));
+    std::string_view fruit("banana");
+    cout << "\nFound " << fruit << ": " << vt.find(fruit)->second << endl;
+
+    // Memory accounting and allocation counts
+    AVLTree<int,std::string> st;
+    for(int i = 0; i < 100; i++) {
+        st.insert(std::make_pair(i, std::string(40, 'x')));
+    }
+    cout << "\nAVLTree<int,string> size " << st.size() << ": " << st.memoryUsage() << endl;
+    AllocScope findScope;
+    int found = 0;
+    for(int i = 0; i < 100; i++) {
+        found += (st.find(i) != st.end());
+    }
+    cout << "Allocations during " << found << " finds: " << findScope.allocations() << endl;
+    AllocScope iterScope;
+    size_t chars = 0;
+    for(AVLTree<int,std::string>::iterator it = st.begin(); it != st.end(); ++it) {
+        chars += it->second.size();
+    }
+    cout << "Allocations iterating " << chars << " chars: " << iterScope.allocations() << endl;
+    std::pair<const int, std::string> update(7, std::string(30, 'y'));
+    AllocScope updateScope;
+    st.insert(update);
+    st[8] = update.second;
+    cout << "Allocations during in-place updates: " << updateScope.allocations() << endl;
+
+    // Lazy deletion
+    at.setLazyDelete(true);
+    at.remove('a');
+    cout << "\nAfter lazy remove of a: size " << at.size() << ", tombstones " << at.tombstones()
+         << ", found a: " << (at.find('a') != at.end()) << endl;
+    at.compact();
+    cout << "After compact: tombstones " << at.tombstones() << endl;
+
+    // Parallel scan over roughly equal chunks
+    cout << "\nPartitioned into " << st.partition(4).size() << " chunks" << endl;
+    st.parallelForEach(truncateValue, 4);
+    cout << "Value of 50 after parallel scan: " << st[50] << endl;
 
     return 0;
 }
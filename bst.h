@@ -4,7 +4,20 @@
 #include <iostream>
 #include <exception>
 #include <cstdlib>
+#include <stdexcept>
+#include <typeinfo>
 #include <utility>
+#include <vector>
+#include <functional>
+#include "bst_compare.h"
+#include "bst_stats.h"
+#include "bst_latency.h"
+#include "bst_cache.h"
+#include "bst_memory.h"
+#include "bst_layout.h"
+#include "work_stealing.h"
+
+struct TreeExportOptions;
 
 /**
  * A templated class for a Node in a search tree.
@@ -29,6 +42,7 @@ public:
     virtual Node<Key, Value>* getParent() const;
     virtual Node<Key, Value>* getLeft() const;
     virtual Node<Key, Value>* getRight() const;
+    virtual bool isTombstone() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
@@ -36,7 +50,8 @@ public:
     void setValue(const Value &value);
 
 protected:
-    std::pair<const Key, Value> item_;
+    // the pair itself, or a key copy and a pointer to it; see ColdValue
+    NodeItem<Key, Value> item_;
     Node<Key, Value>* parent_;
     Node<Key, Value>* left_;
     Node<Key, Value>* right_;
@@ -78,7 +93,7 @@ Node<Key, Value>::~Node()
 template<typename Key, typename Value>
 const std::pair<const Key, Value>& Node<Key, Value>::getItem() const
 {
-    return item_;
+    return item_.item();
 }
 
 /**
@@ -87,7 +102,7 @@ const std::pair<const Key, Value>& Node<Key, Value>::getItem() const
 template<typename Key, typename Value>
 std::pair<const Key, Value>& Node<Key, Value>::getItem()
 {
-    return item_;
+    return item_.item();
 }
 
 /**
@@ -96,7 +111,7 @@ std::pair<const Key, Value>& Node<Key, Value>::getItem()
 template<typename Key, typename Value>
 const Key& Node<Key, Value>::getKey() const
 {
-    return item_.first;
+    return item_.key();
 }
 
 /**
@@ -105,7 +120,7 @@ const Key& Node<Key, Value>::getKey() const
 template<typename Key, typename Value>
 const Value& Node<Key, Value>::getValue() const
 {
-    return item_.second;
+    return item_.item().second;
 }
 
 /**
@@ -114,7 +129,7 @@ const Value& Node<Key, Value>::getValue() const
 template<typename Key, typename Value>
 Value& Node<Key, Value>::getValue()
 {
-    return item_.second;
+    return item_.item().second;
 }
 
 /**
@@ -144,6 +159,16 @@ Node<Key, Value>* Node<Key, Value>::getRight() const
     return right_;
 }
 
+/**
+* Whether the node has been lazily deleted. Plain nodes never are; see
+* AVLTree::setLazyDelete.
+*/
+template<typename Key, typename Value>
+bool Node<Key, Value>::isTombstone() const
+{
+    return false;
+}
+
 /**
 * A setter for setting the parent of a node.
 */
@@ -177,7 +202,7 @@ void Node<Key, Value>::setRight(Node<Key, Value>* right)
 template<typename Key, typename Value>
 void Node<Key, Value>::setValue(const Value& value)
 {
-    item_.second = value;
+    item_.item().second = value;
 }
 
 /*
@@ -187,13 +212,140 @@ void Node<Key, Value>::setValue(const Value& value)
 */
 
 /**
-* A templated unbalanced binary search tree.
+* Owns a node taken out of a tree by extract(). The key and value stay in
+* the node, so insert(NodeHandle&&) can link it into another tree of the
+* same type without allocating or copying either. An empty handle owns
+* nothing; a handle that still owns a node frees it when destroyed.
 */
 template <typename Key, typename Value>
+class NodeHandle
+{
+public:
+    NodeHandle();
+    NodeHandle(NodeHandle&& other);
+    NodeHandle& operator=(NodeHandle&& other);
+    ~NodeHandle();
+
+    bool empty() const;
+    explicit operator bool() const;
+    const Key& key() const;
+    Value& mapped() const;
+
+private:
+    template <typename K, typename V, typename C> friend class BinarySearchTree;
+
+    NodeHandle(Node<Key, Value>* node, const std::type_info* treeType);
+    Node<Key, Value>* release();
+
+    Node<Key, Value>* node_;
+    const std::type_info* treeType_;  // the dynamic type of the tree it came from
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the NodeHandle class.
+  -----------------------------------------------
+*/
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::NodeHandle() :
+    node_(nullptr), treeType_(nullptr)
+{
+
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::NodeHandle(Node<Key, Value>* node, const std::type_info* treeType) :
+    node_(node), treeType_(treeType)
+{
+
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::NodeHandle(NodeHandle&& other) :
+    node_(other.node_), treeType_(other.treeType_)
+{
+    other.node_ = nullptr;
+    other.treeType_ = nullptr;
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>& NodeHandle<Key, Value>::operator=(NodeHandle&& other)
+{
+    if (this != &other)
+    {
+        delete node_;
+        node_ = other.node_;
+        treeType_ = other.treeType_;
+        other.node_ = nullptr;
+        other.treeType_ = nullptr;
+    }
+    return *this;
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::~NodeHandle()
+{
+    delete node_;
+}
+
+template<typename Key, typename Value>
+bool NodeHandle<Key, Value>::empty() const
+{
+    return node_ == nullptr;
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::operator bool() const
+{
+    return node_ != nullptr;
+}
+
+/**
+* The key of the owned node; the handle must not be empty.
+*/
+template<typename Key, typename Value>
+const Key& NodeHandle<Key, Value>::key() const
+{
+    return node_->getKey();
+}
+
+/**
+* The value of the owned node, which may be changed before reinserting it;
+* the handle must not be empty.
+*/
+template<typename Key, typename Value>
+Value& NodeHandle<Key, Value>::mapped() const
+{
+    return node_->getValue();
+}
+
+/**
+* Gives up ownership of the node, leaving the handle empty.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* NodeHandle<Key, Value>::release()
+{
+    Node<Key, Value>* node = node_;
+    node_ = nullptr;
+    treeType_ = nullptr;
+    return node;
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the NodeHandle class.
+  ---------------------------------------------
+*/
+
+/**
+* A templated unbalanced binary search tree.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
 class BinarySearchTree
 {
 public:
-    BinarySearchTree(); //TODO
+    explicit BinarySearchTree(const Compare& compare = Compare()); //TODO
     virtual ~BinarySearchTree(); //TODO
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
@@ -201,6 +353,21 @@ public:
     bool isBalanced() const; //TODO
     void print() const;
     bool empty() const;
+    size_t size() const;
+    MemoryUsage memoryUsage() const;
+    TreeStats stats() const;
+    void resetStats();
+    void enableLatencyTracking(unsigned sampleEvery = 1);
+    void disableLatencyTracking();
+    const LatencyHistogram* latency(TreeOp op) const;
+    void printLatency(std::ostream& os) const;
+    void enableLookupCache(size_t slots = 64);
+    void disableLookupCache();
+    LookupCacheStats lookupCacheStats() const;
+    void exportDot(std::ostream& os) const;
+    void exportDot(std::ostream& os, const TreeExportOptions& opts) const;
+    void exportJson(std::ostream& os) const;
+    void exportJson(std::ostream& os, const TreeExportOptions& opts) const;
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
@@ -222,21 +389,54 @@ public:
         iterator& operator++();
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
+        friend class BinarySearchTree<Key, Value, Compare>;
+        iterator(Node<Key,Value>* ptr, const size_t* tombstones);
         Node<Key, Value> *current_;
+        // the owning tree's tombstone count, so that advancing only checks
+        // nodes for tombstones while the tree has any
+        const size_t* tombstones_;
     };
 
 public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key) const;
+    Compare keyCompare() const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
+    std::pair<iterator, bool> tryInsert(const std::pair<const Key, Value>& keyValuePair);
+
+    typedef NodeHandle<Key, Value> node_type;
+
+    /**
+    * The result of insert(node_type&&): where the key is, whether the node
+    * went in and, if it did not (the key was already there), the node back.
+    */
+    struct insert_return_type
+    {
+        iterator position;
+        bool inserted;
+        node_type node;
+    };
+
+    node_type extract(const Key& key);
+    node_type extract(iterator pos);
+    insert_return_type insert(node_type&& nh);
+    void merge(BinarySearchTree<Key, Value, Compare>& other);
+
+    typedef std::pair<iterator, iterator> range;
+    std::vector<range> partition(size_t k) const;
+    template<typename Function>
+    void parallelForEach(Function fn, unsigned threads = 0) const;
 
 protected:
     // Mandatory helper functions
-    Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    virtual Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    Node<Key, Value>* cachedFind(const Key& key) const;
+    template<typename K>
+    Node<Key, Value>* findNode(const K& key) const;
     Node<Key, Value> *getSmallestNode() const;  // TODO
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
@@ -247,10 +447,24 @@ protected:
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
 
     // Add helper functions here
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual Node<Key, Value>* insertOrFind(const Key& key, const Value& value, bool& added);
+    virtual void destroyNode(Node<Key, Value>* node);
+    virtual void adoptNode(Node<Key, Value>* node);
+    virtual void releaseNode(Node<Key, Value>* node);
+    virtual void unlinkNode(Node<Key, Value>* node);
+    virtual Node<Key, Value>* linkNode(Node<Key, Value>* node);
+    node_type detachNode(Node<Key, Value>* node);
+    virtual size_t nodeSize() const;
+    virtual size_t auxiliaryBytes() const;
+    virtual bool nodeBalance(const Node<Key, Value>* node, int& balance) const;
     int calculateHeightIfBalanced(const Node<Key, Value>* root) const;
     bool isBalancedHelper(const Node<Key, Value>* root) const;
     void destroyTree(Node<Key, Value>* root);
+    static void collectTopLevels(Node<Key, Value>* root, unsigned levels,
+                                 std::vector<Node<Key, Value>*>& out);
     static Node<Key, Value>* successor(Node<Key, Value>* current);
+    static Node<Key, Value>* firstLiveNode(Node<Key, Value>* current);
     static bool isRightChild(Node<Key, Value>* current);
     static bool isLeftChild(Node<Key, Value>* current);
     Node<Key, Value>* thoroughInternalFind(Node<Key, Value>* curr, const Key& k) const;
@@ -263,6 +477,14 @@ protected:
 protected:
     Node<Key, Value>* root_;
     // You should not need other data members
+    size_t size_;        // nodes allocated, including tombstones
+    size_t tombstones_;  // nodes lazily deleted but not yet freed
+    LatencyRecorder* latency_;  // NULL unless latency tracking is enabled
+    mutable LookupCache<Key, Value>* lookupCache_;  // NULL unless enabled
+    Compare compare_;
+#ifdef BST_STATS
+    mutable TreeCounters stats_;
+#endif
 };
 
 /*
@@ -272,31 +494,34 @@ Begin implementations for the BinarySearchTree::iterator class.
 */
 
 /**
-* Explicit constructor that initializes an iterator with a given node pointer.
+* Explicit constructor that initializes an iterator with a given node pointer
+* and the tombstone count of the tree it belongs to.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator(Node<Key,Value> *ptr, const size_t* tombstones)
 {
     // TODO
     current_ = ptr;
+    tombstones_ = tombstones;
 }
 
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator() 
 {
     // TODO
     current_ = nullptr;
+    tombstones_ = nullptr;
 }
 
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator*() const
 {
     return current_->getItem();
 }
@@ -304,9 +529,9 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
@@ -315,10 +540,10 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     // TODO
 
@@ -336,10 +561,10 @@ BinarySearchTree<Key, Value>::iterator::operator==(
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     // TODO
     return !(*this == rhs);
@@ -349,14 +574,18 @@ BinarySearchTree<Key, Value>::iterator::operator!=(
 /**
 * Advances the iterator's location using an in-order sequencing
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator&
+BinarySearchTree<Key, Value, Compare>::iterator::operator++()
 {
     // TODO
     // make the iterator point to the successor
 
     this->current_ = successor(this->current_);
+    if (*this->tombstones_)
+    {
+        this->current_ = firstLiveNode(this->current_);
+    }
 
     return *this;
 }
@@ -377,55 +606,217 @@ Begin implementations for the BinarySearchTree class.
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(const Compare& compare) :
+    compare_(compare)
 {
     // TODO
     root_ = nullptr;
+    size_ = 0;
+    tombstones_ = 0;
+    latency_ = nullptr;
+    lookupCache_ = nullptr;
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::~BinarySearchTree()
 {
     // TODO
     clear();
+    delete latency_;
+    delete lookupCache_;
 }
 
 /**
  * Returns true if tree is empty
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::empty() const
 {
-    return root_ == NULL;
+    return size_ == tombstones_;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+/**
+ * Returns the number of items in the tree
+*/
+template<class Key, class Value, class Compare>
+size_t BinarySearchTree<Key, Value, Compare>::size() const
+{
+    return size_ - tombstones_;
+}
+
+/**
+* Reports the bytes used by the nodes, the estimated malloc overhead for
+* them, the heap memory owned by keys and values (see HeapUsage) and by
+* out-of-line items (see ColdValue), and the tree object itself. O(1)
+* unless Key or Value owns heap memory.
+*/
+template<class Key, class Value, class Compare>
+MemoryUsage BinarySearchTree<Key, Value, Compare>::memoryUsage() const
+{
+    MemoryUsage usage;
+    addNodeMemory(usage, size_, nodeSize());
+    if (NodeItem<Key, Value>::outOfLineBytes)
+    {
+        usage.keyValueHeapBytes += size_ * NodeItem<Key, Value>::outOfLineBytes;
+    }
+    usage.treeBytes = sizeof(*this);
+    if (latency_)
+    {
+        usage.treeBytes += sizeof(*latency_);
+    }
+    if (lookupCache_)
+    {
+        usage.treeBytes += lookupCache_->bytes();
+    }
+    usage.treeBytes += auxiliaryBytes();
+
+    if ((HeapUsage<Key>::dynamic || HeapUsage<Value>::dynamic) && root_)
+    {
+        for (iterator it = begin(); it != end(); ++it)
+        {
+            usage.keyValueHeapBytes += NodeItem<Key, Value>::keyCopies * HeapUsage<Key>::bytes(it->first) +
+                                       HeapUsage<Value>::bytes(it->second);
+        }
+    }
+    return usage;
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::print() const
 {
     printRoot(root_);
     std::cout << "\n";
 }
 
+/**
+* Returns a snapshot of the operation counters (all zero unless
+* compiled with BST_STATS). The counters are relaxed atomics, so const
+* lookups from several threads may count concurrently.
+*/
+template<typename Key, typename Value, typename Compare>
+TreeStats BinarySearchTree<Key, Value, Compare>::stats() const
+{
+#ifdef BST_STATS
+    return stats_.snapshot();
+#else
+    return TreeStats();
+#endif
+}
+
+/**
+* Zeroes the operation counters.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::resetStats()
+{
+#ifdef BST_STATS
+    stats_.reset();
+#endif
+}
+
+/**
+* Starts timing 1 in sampleEvery calls of each operation into a per-operation
+* latency histogram. Calling it again resets the histograms. The recorder
+* is atomic, so const lookups from several threads may record at once;
+* enabling or disabling tracking is a modification of the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::enableLatencyTracking(unsigned sampleEvery)
+{
+    delete latency_;
+    latency_ = new LatencyRecorder(sampleEvery);
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::disableLatencyTracking()
+{
+    delete latency_;
+    latency_ = nullptr;
+}
+
+/**
+* Returns the histogram for op, or NULL if latency tracking is disabled.
+*/
+template<typename Key, typename Value, typename Compare>
+const LatencyHistogram* BinarySearchTree<Key, Value, Compare>::latency(TreeOp op) const
+{
+    return latency_ ? &latency_->histograms[op] : nullptr;
+}
+
+/**
+* Prints one line of percentiles per operation.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::printLatency(std::ostream& os) const
+{
+    if (!latency_)
+    {
+        os << "latency tracking disabled" << std::endl;
+        return;
+    }
+    for (int op = 0; op < NUM_TREE_OPS; ++op)
+    {
+        os << "op=" << treeOpName((TreeOp)op) << " ";
+        latency_->histograms[op].print(os);
+        os << std::endl;
+    }
+}
+
+/**
+* Puts a direct-mapped cache of slots (rounded up to a power of two) node
+* pointers in front of find and operator[]: a lookup first checks the slot
+* its key hashes to and only descends the tree on a miss, then remembers
+* the node it found. Worth it when a few hot keys take most lookups; check
+* with lookupCacheStats. Calling it again empties the cache and zeroes the
+* counters.
+*
+* Lookups update the cache, so with the cache enabled concurrent const
+* lookups from several threads are no longer safe.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::enableLookupCache(size_t slots)
+{
+    delete lookupCache_;
+    lookupCache_ = new LookupCache<Key, Value>(slots);
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::disableLookupCache()
+{
+    delete lookupCache_;
+    lookupCache_ = nullptr;
+}
+
+/**
+* Returns the cache's hit and miss counts, or zeros if it is disabled.
+*/
+template<typename Key, typename Value, typename Compare>
+LookupCacheStats BinarySearchTree<Key, Value, Compare>::lookupCacheStats() const
+{
+    return lookupCache_ ? lookupCache_->stats : LookupCacheStats();
+}
+
 /**
 * Returns an iterator to the "smallest" item in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::begin() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
+    BinarySearchTree<Key, Value, Compare>::iterator begin(tombstones_ ? firstLiveNode(getSmallestNode()) : getSmallestNode(),
+                                                          &tombstones_);
     return begin;
 }
 
 /**
 * Returns an iterator whose value means INVALID
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::end() const
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
+    BinarySearchTree<Key, Value, Compare>::iterator end(NULL, &tombstones_);
     return end;
 }
 
@@ -433,91 +824,253 @@ BinarySearchTree<Key, Value>::end() const
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const Key & k) const
 {
-    Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
+    BST_COUNT(finds, 1);
+    LatencyTimer timer(latency_, OP_FIND);
+    Node<Key, Value> *curr = cachedFind(k);
+    BinarySearchTree<Key, Value, Compare>::iterator it(curr, &tombstones_);
     return it;
 }
 
+/**
+* Heterogeneous lookup, available when Compare is transparent (e.g.
+* std::less<>): finds the item whose key is equivalent to k without
+* building a Key, e.g. find(std::string_view) on std::string keys.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const K& k) const
+{
+    BST_COUNT(finds, 1);
+    LatencyTimer timer(latency_, OP_FIND);
+    return iterator(findNode(k), &tombstones_);
+}
+
+/**
+* Returns a copy of the comparison object the tree orders its keys by.
+*/
+template<class Key, class Value, class Compare>
+Compare BinarySearchTree<Key, Value, Compare>::keyCompare() const
+{
+    return compare_;
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
  */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+template<class Key, class Value, class Compare>
+Value& BinarySearchTree<Key, Value, Compare>::operator[](const Key& key)
 {
-    Node<Key, Value> *curr = internalFind(key);
+    BST_COUNT(finds, 1);
+    LatencyTimer timer(latency_, OP_FIND);
+    Node<Key, Value> *curr = cachedFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
     return curr->getValue();
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+template<class Key, class Value, class Compare>
+Value const & BinarySearchTree<Key, Value, Compare>::operator[](const Key& key) const
 {
-    Node<Key, Value> *curr = internalFind(key);
+    BST_COUNT(finds, 1);
+    LatencyTimer timer(latency_, OP_FIND);
+    Node<Key, Value> *curr = cachedFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
     return curr->getValue();
 }
 
+/**
+* Takes the node holding key out of the tree, rebalancing as remove does,
+* but hands it over in a node handle instead of freeing it. Returns an
+* empty handle if the key is not in the tree.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::node_type
+BinarySearchTree<Key, Value, Compare>::extract(const Key& key)
+{
+    BST_COUNT(removes, 1);
+    LatencyTimer timer(latency_, OP_REMOVE);
+    Node<Key, Value>* node = internalFind(key);
+    if (!node)
+    {
+        return node_type();
+    }
+    return detachNode(node);
+}
+
+/**
+* Takes the node at pos out of the tree; see extract(const Key&). Other
+* iterators stay valid.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::node_type
+BinarySearchTree<Key, Value, Compare>::extract(iterator pos)
+{
+    BST_COUNT(removes, 1);
+    LatencyTimer timer(latency_, OP_REMOVE);
+    if (!pos.current_)
+    {
+        return node_type();
+    }
+    return detachNode(pos.current_);
+}
+
+/**
+* Links the node owned by nh into the tree, without allocating or copying
+* its key and value. If the key is already present the tree is unchanged
+* and the node comes back in the result. The handle must come from a tree
+* of exactly this type (std::invalid_argument otherwise), since the node's
+* type and the data it carries depend on the tree.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::insert_return_type
+BinarySearchTree<Key, Value, Compare>::insert(node_type&& nh)
+{
+    BST_COUNT(inserts, 1);
+    LatencyTimer timer(latency_, OP_INSERT);
+    insert_return_type result;
+    result.inserted = false;
+    if (nh.empty())
+    {
+        return result;
+    }
+    if (*nh.treeType_ != typeid(*this))
+    {
+        throw std::invalid_argument("node handle from a different type of tree");
+    }
+
+    Node<Key, Value>* node = nh.node_;
+    Node<Key, Value>* linked = linkNode(node);
+    result.position = iterator(linked, &tombstones_);
+    if (linked != node)
+    {
+        result.node = std::move(nh);
+        return result;
+    }
+    nh.release();
+    adoptNode(node);
+    result.inserted = true;
+    return result;
+}
+
+/**
+* Moves every node of other whose key is not in this tree over, relinking
+* the nodes rather than copying their items; O(m log(n + m)) for m moved
+* nodes. Keys already here stay in other, as do other's lazily deleted
+* nodes. Both trees must have the same type (std::invalid_argument
+* otherwise).
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::merge(BinarySearchTree<Key, Value, Compare>& other)
+{
+    if (&other == this)
+    {
+        return;
+    }
+    if (typeid(other) != typeid(*this))
+    {
+        throw std::invalid_argument("merge of a different type of tree");
+    }
+
+    Node<Key, Value>* node = other.getSmallestNode();
+    while (node)
+    {
+        // taking nodes out never moves the ones after them in order
+        Node<Key, Value>* next = successor(node);
+        if (!node->isTombstone() && !internalFind(node->getKey()))
+        {
+            other.unlinkNode(node);
+            other.releaseNode(node);
+            linkNode(node);
+            adoptNode(node);
+        }
+        node = next;
+    }
+}
+
 /**
 * An insert method to insert into a Binary Search Tree.
 * The tree will not remain balanced when inserting.
 * Recall: If key is already in the tree, you should 
 * overwrite the current value with the updated value.
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
     // TODO
-    
-    // in another way
-    Key insertKey = keyValuePair.first;
-    Value insertValue = keyValuePair.second;
+    BST_COUNT(inserts, 1);
+    LatencyTimer timer(latency_, OP_INSERT);
 
-    // empty tree - make the pair the root
-    if (!root_)
+    bool added = false;
+    Node<Key, Value>* node = insertOrFind(keyValuePair.first, keyValuePair.second, added);
+    if (!added)
     {
-        root_ = new Node<Key, Value>(insertKey, insertValue, nullptr);
+        node->setValue(keyValuePair.second);
     }
-    else
+}
+
+/**
+* Inserts the pair only if its key is absent; an existing value is left
+* alone, as std::map::insert does. Returns the key's position and whether
+* the pair went in. One descent either way, so callers that update an
+* existing value in place (AVLMultiMap appending to a bucket) need no
+* separate find.
+*/
+template<class Key, class Value, class Compare>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::tryInsert(const std::pair<const Key, Value>& keyValuePair)
+{
+    BST_COUNT(inserts, 1);
+    LatencyTimer timer(latency_, OP_INSERT);
+    bool added = false;
+    Node<Key, Value>* node = insertOrFind(keyValuePair.first, keyValuePair.second, added);
+    return std::make_pair(iterator(node, &tombstones_), added);
+}
+
+/**
+* The descent shared by insert and tryInsert: links a new node for key and
+* sets added, or returns the node already holding key untouched. The tree
+* stays unbalanced.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::insertOrFind(const Key& key, const Value& value, bool& added)
+{
+    added = true;
+    if (!root_)
     {
-        Node<Key, Value>* current = root_;
-        bool beenInserted = false;
+        root_ = createNode(key, value, nullptr);
+        return root_;
+    }
 
-        while (!beenInserted)
+    Node<Key, Value>* current = root_;
+    while (true)
+    {
+        BST_COUNT(nodeVisits, 1);
+        BST_COUNT(comparisons, 1);
+        int cmp = KeyComparator<Compare>::compare(compare_, key, current->getKey());
+        if (cmp == 0)
+        {
+            added = false;
+            return current;
+        }
+        Node<Key, Value>* next = cmp < 0 ? current->getLeft() : current->getRight();
+        if (!next)
         {
-            if (insertKey == current->getKey())
+            Node<Key, Value>* node = createNode(key, value, current);
+            if (cmp < 0)
             {
-                current->setValue(insertValue);
-                beenInserted = true;
+                current->setLeft(node);
             }
-            else if (insertKey < current->getKey())
-            {
-                if (current->getLeft())
-                {
-                    current = current->getLeft();
-                }
-                else
-                {
-                    current->setLeft(new Node<Key, Value>(insertKey, insertValue, current));
-                    beenInserted = true;
-                }
-            } 
             else
             {
-                if (current->getRight())
-                {
-                    current = current->getRight();
-                }
-                else
-                {
-                    current->setRight(new Node<Key, Value>(insertKey, insertValue, current));
-                    beenInserted = true;
-                }
+                current->setRight(node);
             }
+            return node;
         }
+        current = next;
     }
 }
 
@@ -527,10 +1080,12 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 * Recall: The writeup specifies that if a node has 2 children you
 * should swap with the predecessor and then remove.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::remove(const Key& key)
 {
     // TODO
+    BST_COUNT(removes, 1);
+    LatencyTimer timer(latency_, OP_REMOVE);
     Node<Key, Value>* toRemove = internalFind(key);
 
     if (!root_)
@@ -545,6 +1100,17 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         return;
     }
 
+    unlinkNode(toRemove);
+    destroyNode(toRemove);
+}
+
+/**
+* Takes toRemove out of the tree's structure without freeing it; remove
+* and extract share it. The node's own links are left stale.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::unlinkNode(Node<Key, Value>* toRemove)
+{
     // removal cases
 
     if (!toRemove->getLeft() && !toRemove->getRight())
@@ -597,8 +1163,8 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     }    
 }
 
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::removeZeroChildren(Node<Key, Value>* removeMe)
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::removeZeroChildren(Node<Key, Value>* removeMe)
 {
     if (!removeMe->getParent())
     {
@@ -613,12 +1179,10 @@ void BinarySearchTree<Key, Value>::removeZeroChildren(Node<Key, Value>* removeMe
     {
         removeMe->getParent()->setRight(nullptr);
     }
-
-    delete removeMe;
 }
 
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::removeWithLeftChild(Node<Key, Value>* removeMe)
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::removeWithLeftChild(Node<Key, Value>* removeMe)
 {
     bool isRoot = false;
     if (removeMe == root_)
@@ -639,16 +1203,14 @@ void BinarySearchTree<Key, Value>::removeWithLeftChild(Node<Key, Value>* removeM
         removeMe->getRight()->setParent(child);
     }
 
-    delete removeMe;
-
     if (isRoot)
     {
         root_ = child;
     }
 }
 
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::removeWithRightChild(Node<Key, Value>* removeMe)
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::removeWithRightChild(Node<Key, Value>* removeMe)
 {
     bool isRoot = false;
     if (removeMe == root_)
@@ -667,8 +1229,6 @@ void BinarySearchTree<Key, Value>::removeWithRightChild(Node<Key, Value>* remove
     {
         removeMe->getLeft()->setParent(child);
     }
-    
-    delete removeMe;
 
     if (isRoot)
     {
@@ -676,9 +1236,9 @@ void BinarySearchTree<Key, Value>::removeWithRightChild(Node<Key, Value>* remove
     }
 }
 
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare>::predecessor(Node<Key, Value>* current)
 {
     // TODO
     Node<Key, Value>* pred = nullptr;
@@ -718,9 +1278,9 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
     return pred;
 }
 
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare>::successor(Node<Key, Value>* current)
 {
     if (!current)
     {
@@ -759,8 +1319,22 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
     return succ;
 }
 
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::isRightChild(Node<Key, Value>* current)
+/**
+* Returns current, or the first node after it that is not a tombstone.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::firstLiveNode(Node<Key, Value>* current)
+{
+    while (current && current->isTombstone())
+    {
+        current = successor(current);
+    }
+    return current;
+}
+
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::isRightChild(Node<Key, Value>* current)
 {
     bool isRight = false;
 
@@ -779,8 +1353,8 @@ bool BinarySearchTree<Key, Value>::isRightChild(Node<Key, Value>* current)
     return isRight;
 }
 
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::isLeftChild(Node<Key, Value>* current)
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::isLeftChild(Node<Key, Value>* current)
 {
     bool isLeft = false;
 
@@ -803,18 +1377,20 @@ bool BinarySearchTree<Key, Value>::isLeftChild(Node<Key, Value>* current)
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::clear()
 {
     // TODO
+    LatencyTimer timer(latency_, OP_CLEAR);
     destroyTree(root_);
 
     root_ = nullptr;
-    
+    tombstones_ = 0;
+    NodeItem<Key, Value>::trim();
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::destroyTree(Node<Key, Value>* root)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::destroyTree(Node<Key, Value>* root)
 {
     if (!root)
     {
@@ -823,21 +1399,138 @@ void BinarySearchTree<Key, Value>::destroyTree(Node<Key, Value>* root)
 
     destroyTree(root->getLeft());
     destroyTree(root->getRight());
-    delete root;
+    destroyNode(root);
     root = nullptr;
 }
 
+/**
+* Allocates a node for the tree. Every node the tree owns is created here
+* and freed by destroyNode, which keeps size() up to date; derived trees
+* override these to allocate their own node type.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    Node<Key, Value>* node = new Node<Key, Value>(key, value, parent);
+    ++size_;
+    return node;
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+    releaseNode(node);
+    delete node;
+}
+
+/**
+* The bookkeeping half of createNode, for a node that already exists and
+* has just been linked in by insert(node_type&&) or merge. Derived trees
+* that track their nodes elsewhere override it together with releaseNode.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::adoptNode(Node<Key, Value>*)
+{
+    ++size_;
+}
+
+/**
+* The bookkeeping half of destroyNode: forgets an unlinked node without
+* freeing it.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::releaseNode(Node<Key, Value>* node)
+{
+    if (lookupCache_)
+    {
+        lookupCache_->erase(node);
+    }
+    --size_;
+}
+
+/**
+* Links a node from another tree of this type in as a new leaf, or
+* returns the node already holding its key and leaves it out.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::linkNode(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = nullptr;
+    Node<Key, Value>* current = root_;
+    int cmp = 0;
+    while (current)
+    {
+        BST_COUNT(nodeVisits, 1);
+        BST_COUNT(comparisons, 1);
+        cmp = KeyComparator<Compare>::compare(compare_, node->getKey(), current->getKey());
+        if (cmp == 0)
+        {
+            return current;
+        }
+        parent = current;
+        current = cmp < 0 ? current->getLeft() : current->getRight();
+    }
+
+    node->setParent(parent);
+    node->setLeft(nullptr);
+    node->setRight(nullptr);
+    if (!parent)
+    {
+        root_ = node;
+    }
+    else if (cmp < 0)
+    {
+        parent->setLeft(node);
+    }
+    else
+    {
+        parent->setRight(node);
+    }
+    return node;
+}
+
+/**
+* Unlinks and forgets node and hands it out in a node handle.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::node_type
+BinarySearchTree<Key, Value, Compare>::detachNode(Node<Key, Value>* node)
+{
+    unlinkNode(node);
+    releaseNode(node);
+    return node_type(node, &typeid(*this));
+}
+
+/**
+* The size of the node type that createNode allocates.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t BinarySearchTree<Key, Value, Compare>::nodeSize() const
+{
+    return sizeof(Node<Key, Value>);
+}
+
+/**
+* Heap bytes a subclass keeps beside the nodes (e.g. an index); counted in
+* memoryUsage's treeBytes.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t BinarySearchTree<Key, Value, Compare>::auxiliaryBytes() const
+{
+    return 0;
+}
+
 
 /**
 * A helper function to find the smallest node in the tree.
 */
-template<typename Key, typename Value>
+template<typename Key, typename Value, typename Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+BinarySearchTree<Key, Value, Compare>::getSmallestNode() const
 {
     // TODO
     Node<Key, Value>* currentSmallest = root_;
-    while (currentSmallest->getLeft()) 
+    while (currentSmallest && currentSmallest->getLeft()) 
     {
         currentSmallest = currentSmallest->getLeft();
     }
@@ -847,46 +1540,181 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
 }
 
 /**
-* Helper function to find a node with given key, k and
-* return a pointer to it or NULL if no item with that key
-* exists
+* Splits the in-order sequence into at most k contiguous, non-empty ranges
+* [first, second) that together cover the tree. The split points are taken
+* from the top few levels of the tree, so no counting pass is needed and the
+* ranges are roughly equal in size when the tree is balanced.
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Compare>
+std::vector<typename BinarySearchTree<Key, Value, Compare>::range>
+BinarySearchTree<Key, Value, Compare>::partition(size_t k) const
 {
-    // TODO
-    Node<Key, Value>* finder = root_;
-    bool found = false;
-    while (!found)
+    std::vector<range> chunks;
+    if (empty() || k == 0)
+    {
+        return chunks;
+    }
+
+    // two levels more than log2(k) give about 4 candidate split points per
+    // chunk boundary to choose from
+    unsigned levels = 2;
+    while (((size_t)1 << (levels - 2)) < k)
+    {
+        ++levels;
+    }
+    std::vector<Node<Key, Value>*> splits;
+    collectTopLevels(root_, levels, splits);
+
+    iterator chunkBegin = begin();
+    for (size_t j = 1; j < k; ++j)
     {
-        if (!finder)
+        size_t index = j * (splits.size() + 1) / k;
+        if (index == 0)
         {
-            // not in tree, return nullptr
-            found = true;
+            continue;
         }
-        else if (finder->getKey() == key)
+        iterator chunkEnd(firstLiveNode(splits[index - 1]), &tombstones_);
+        if (chunkEnd != chunkBegin)
         {
-            found = true;
+            chunks.push_back(range(chunkBegin, chunkEnd));
+            chunkBegin = chunkEnd;
         }
-        else if (key < finder->getKey()) 
+    }
+    if (chunkBegin != end())
+    {
+        chunks.push_back(range(chunkBegin, end()));
+    }
+    return chunks;
+}
+
+/**
+* Appends the nodes in the top `levels` levels of the subtree in key order.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::collectTopLevels(Node<Key, Value>* root, unsigned levels,
+                                                    std::vector<Node<Key, Value>*>& out)
+{
+    if (!root || levels == 0)
+    {
+        return;
+    }
+    collectTopLevels(root->getLeft(), levels - 1, out);
+    out.push_back(root);
+    collectTopLevels(root->getRight(), levels - 1, out);
+}
+
+/**
+* Calls fn(std::pair<const Key, Value>&) for every item, in parallel on
+* `threads` threads (0 means one per hardware thread). The tree is split
+* into several chunks per thread with partition() and the chunks are
+* scheduled with work stealing, so items are visited in key order within a
+* chunk but chunks run concurrently. fn may modify values but the tree must
+* not be modified during the call.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Function>
+void BinarySearchTree<Key, Value, Compare>::parallelForEach(Function fn, unsigned threads) const
+{
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    std::vector<range> chunks = partition(threads > 1 ? 4 * (size_t)threads : 1);
+
+    struct ChunkTask
+    {
+        const std::vector<range>* chunks;
+        Function* fn;
+        void operator()(size_t t) const
         {
-            finder = finder->getLeft();
-        } 
-        else 
+            for (iterator it = (*chunks)[t].first; it != (*chunks)[t].second; ++it)
+            {
+                (*fn)(*it);
+            }
+        }
+    };
+    ChunkTask task = { &chunks, &fn };
+    WorkStealingRun::run(chunks.size(), threads, task);
+}
+
+/**
+* Helper function to find a node with given key, k and
+* return a pointer to it or NULL if no item with that key
+* exists
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFind(const Key& key) const
+{
+    // TODO
+    return findNode(key);
+}
+
+/**
+* internalFind behind the lookup cache, if it is enabled. A cached node
+* stays valid until releaseNode clears its slot: remove, clear and
+* compact free nodes through destroyNode, which calls it, extract and
+* merge call it directly, and nodeSwap relinks
+* nodes without moving their items. A cached node that was lazily deleted
+* counts as a miss.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::cachedFind(const Key& key) const
+{
+    if (!lookupCache_)
+    {
+        return internalFind(key);
+    }
+    Node<Key, Value>*& slot = lookupCache_->slot(key);
+    Node<Key, Value>* node = slot;
+    if (node && !(tombstones_ && node->isTombstone()) &&
+        KeyComparator<Compare>::compare(compare_, key, node->getKey()) == 0)
+    {
+        ++lookupCache_->stats.hits;
+        return node;
+    }
+    ++lookupCache_->stats.misses;
+    node = internalFind(key);
+    if (node)
+    {
+        slot = node;
+    }
+    return node;
+}
+
+/**
+* The descent behind internalFind and heterogeneous find: one three-way
+* comparison per level (see KeyComparator). Lazily deleted nodes count as
+* absent.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findNode(const K& key) const
+{
+    Node<Key, Value>* finder = root_;
+    while (finder)
+    {
+        BST_COUNT(nodeVisits, 1);
+        BST_COUNT(comparisons, 1);
+        int cmp = KeyComparator<Compare>::compare(compare_, key, finder->getKey());
+        if (cmp == 0)
         {
-            finder = finder->getRight();
+            break;
         }
+        finder = cmp < 0 ? finder->getLeft() : finder->getRight();
     }
 
+    if (tombstones_ && finder && finder->isTombstone())
+    {
+        return nullptr;
+    }
     return finder;
-    
 }
 
 // Searches the entire tree structure, even if it is not a proper BST.
 // Used only for when we remove nodes and need to still retrieve a node
 // even if the tree isn't a BST.
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::thoroughInternalFind(Node<Key, Value>* curr, const Key& k) const
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::thoroughInternalFind(Node<Key, Value>* curr, const Key& k) const
 {
     if (!curr)
     {
@@ -909,15 +1737,15 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::thoroughInternalFind(Node<Key, V
 /**
  * Return true iff the BST is balanced.
  */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalanced() const
 {
     // TODO
     return isBalancedHelper(root_);
 }
 
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalancedHelper(const Node<Key, Value>* root) const
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalancedHelper(const Node<Key, Value>* root) const
 {
     if (!root) 
     {
@@ -933,8 +1761,8 @@ bool BinarySearchTree<Key, Value>::isBalancedHelper(const Node<Key, Value>* root
 	}
 }
 
-template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::calculateHeightIfBalanced(const Node<Key, Value>* root) const
+template<typename Key, typename Value, typename Compare>
+int BinarySearchTree<Key, Value, Compare>::calculateHeightIfBalanced(const Node<Key, Value>* root) const
 {
 	// Base case: an empty tree is always balanced and has a height of 0
 	if (root == nullptr) {
@@ -945,8 +1773,8 @@ int BinarySearchTree<Key, Value>::calculateHeightIfBalanced(const Node<Key, Valu
 }
 
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
@@ -1043,6 +1871,9 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
 // include print function (in its own file because it's fairly long)
 #include "print_bst.h"
 
+// include the DOT/JSON exporters, which handle trees of any size
+#include "export_bst.h"
+
 /*
 ---------------------------------------------------
 End implementations for the BinarySearchTree class.
@@ -0,0 +1,148 @@
+#ifndef BST_CACHE_H
+#define BST_CACHE_H
+
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include "bst_compare.h"
+
+template <typename Key, typename Value>
+class Node;
+
+/**
+* Hit and miss counts of a tree's lookup cache. A low hit rate means the
+* cache only adds a hash and a failed probe to every lookup and is better
+* left disabled.
+*/
+struct LookupCacheStats
+{
+    uint64_t hits;
+    uint64_t misses;
+
+    LookupCacheStats() :
+        hits(0), misses(0)
+    {
+
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const LookupCacheStats& s)
+{
+    os << "hits=" << s.hits << " misses=" << s.misses;
+    return os;
+}
+
+/**
+* The hash LookupCache picks slots with: std::hash when Key has one,
+* otherwise 0 (every key shares one slot). A hash only decides where a
+* node is cached; hits are confirmed by comparing keys, so any hash is
+* correct, even one that disagrees with the tree's Compare.
+*/
+template <typename Key, typename = void>
+struct LookupCacheHash
+{
+    static size_t get(const Key&)
+    {
+        return 0;
+    }
+};
+
+template <typename Key>
+struct LookupCacheHash<Key, typename std::enable_if<
+    std::is_invocable_r<size_t, std::hash<Key>, const Key&>::value>::type>
+{
+    static size_t get(const Key& key)
+    {
+        return std::hash<Key>()(key);
+    }
+};
+
+/**
+* A direct-mapped cache from key to the node holding it: each key hashes
+* to one slot, which remembers the node last found for a key in that slot.
+* The owning tree must call erase for every node it frees.
+*/
+template <typename Key, typename Value>
+class LookupCache
+{
+public:
+    explicit LookupCache(size_t slots);
+    ~LookupCache();
+
+    // The slot key maps to; holds a node or NULL.
+    Node<Key, Value>*& slot(const Key& key);
+    void erase(Node<Key, Value>* node);
+    void reset();
+    size_t bytes() const;
+
+    LookupCacheStats stats;
+
+private:
+    LookupCache(const LookupCache&) = delete;
+    LookupCache& operator=(const LookupCache&) = delete;
+
+    Node<Key, Value>** slots_;
+    size_t mask_;  // number of slots - 1
+};
+
+template<typename Key, typename Value>
+LookupCache<Key, Value>::LookupCache(size_t slots)
+{
+    size_t capacity = 1;
+    while (capacity < slots)
+    {
+        capacity *= 2;
+    }
+    slots_ = new Node<Key, Value>*[capacity]();
+    mask_ = capacity - 1;
+}
+
+template<typename Key, typename Value>
+LookupCache<Key, Value>::~LookupCache()
+{
+    delete [] slots_;
+}
+
+/**
+* Hashes are mixed with a multiply so that identity hashes of nearby
+* integers still land in different slots of a small cache.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>*& LookupCache<Key, Value>::slot(const Key& key)
+{
+    uint64_t h = (uint64_t)LookupCacheHash<Key>::get(key) * 0x9E3779B97F4A7C15ULL;
+    return slots_[(h >> 32) & mask_];
+}
+
+template<typename Key, typename Value>
+void LookupCache<Key, Value>::erase(Node<Key, Value>* node)
+{
+    Node<Key, Value>*& s = slot(node->getKey());
+    if (s == node)
+    {
+        s = NULL;
+    }
+}
+
+/**
+* Empties every slot and zeroes the counters.
+*/
+template<typename Key, typename Value>
+void LookupCache<Key, Value>::reset()
+{
+    for (size_t i = 0; i <= mask_; ++i)
+    {
+        slots_[i] = NULL;
+    }
+    stats = LookupCacheStats();
+}
+
+template<typename Key, typename Value>
+size_t LookupCache<Key, Value>::bytes() const
+{
+    return sizeof(*this) + (mask_ + 1) * sizeof(Node<Key, Value>*);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef BST_COMPARE_H
+#define BST_COMPARE_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+* True for std::string and std::string_view (any traits and allocator):
+* the types whose operator< std::less<> resolves to a content comparison.
+*/
+template<typename T>
+struct IsStdString : std::false_type {};
+
+template<typename Traits, typename Alloc>
+struct IsStdString<std::basic_string<char, Traits, Alloc> > : std::true_type {};
+
+template<typename Traits>
+struct IsStdString<std::basic_string_view<char, Traits> > : std::true_type {};
+
+/**
+* Three-way key comparison for the tree descents: compare(less, a, b)
+* returns a negative number, zero or a positive number as a orders before,
+* equivalent to or after b under the strict weak ordering less.
+*
+* The generic version calls less once when a < b and twice otherwise.
+* std::less on strings (and std::less<> when one operand is a std::string
+* or std::string_view and the other converts to std::string_view) uses a
+* single compare() pass instead, so a descent looks at each node's key
+* once. Specialize it for other comparators that have a cheaper three-way
+* form.
+*/
+template<typename Compare>
+struct KeyComparator
+{
+    template<typename A, typename B>
+    static int compare(const Compare& less, const A& a, const B& b)
+    {
+        if (less(a, b))
+        {
+            return -1;
+        }
+        return less(b, a) ? 1 : 0;
+    }
+};
+
+template<typename CharT, typename Traits, typename Alloc>
+struct KeyComparator<std::less<std::basic_string<CharT, Traits, Alloc> > >
+{
+    typedef std::basic_string<CharT, Traits, Alloc> String;
+
+    static int compare(const std::less<String>&, const String& a, const String& b)
+    {
+        return a.compare(b);
+    }
+};
+
+/**
+* std::less<> compares two character pointers by address but a string
+* with anything by content. The string_view pass is only taken when a
+* string is involved, so a tree orders keys exactly as less(a, b) does,
+* like the code that calls the comparator directly.
+*/
+template<>
+struct KeyComparator<std::less<void> >
+{
+    template<typename A, typename B>
+    static int compare(const std::less<void>& less, const A& a, const B& b)
+    {
+        if constexpr ((IsStdString<A>::value || IsStdString<B>::value) &&
+                      std::is_convertible<const A&, std::string_view>::value &&
+                      std::is_convertible<const B&, std::string_view>::value)
+        {
+            return std::string_view(a).compare(std::string_view(b));
+        }
+        else
+        {
+            if (less(a, b))
+            {
+                return -1;
+            }
+            return less(b, a) ? 1 : 0;
+        }
+    }
+};
+
+#endif
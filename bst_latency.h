@@ -0,0 +1,270 @@
+#ifndef BST_LATENCY_H
+#define BST_LATENCY_H
+
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+
+/**
+* A latency histogram in the style of HdrHistogram: values (nanoseconds)
+* are counted in log-linear buckets, each power of two being split into
+* 2^SUB_BUCKET_BITS equal sub-buckets. That bounds the relative error of a
+* reported percentile to about 3% with a fixed 15KB footprint and O(1)
+* recording.
+*
+* Every field is a relaxed atomic, so several threads may record into one
+* histogram (a tree's const lookups can run concurrently); reads taken
+* while others record are not consistent across fields.
+*/
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram& other);
+    LatencyHistogram& operator=(const LatencyHistogram& other);
+
+    void record(uint64_t ns);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+    // The smallest recorded bucket bound such that fraction p (0..1) of
+    // the samples are at or below it.
+    uint64_t percentile(double p) const;
+
+    // Prints count, mean, p50, p90, p99, p99.9, p99.99 and max on one line.
+    void print(std::ostream& os) const;
+
+private:
+    static const int SUB_BUCKET_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    static int bucketIndex(uint64_t ns);
+    static uint64_t bucketUpperBound(int index);
+
+    std::atomic<uint64_t> buckets_[NUM_BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+};
+
+inline LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+inline LatencyHistogram::LatencyHistogram(const LatencyHistogram& other)
+{
+    *this = other;
+}
+
+inline LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other)
+{
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+    {
+        buckets_[i].store(other.buckets_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    count_.store(other.count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    sum_.store(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    min_.store(other.min_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    max_.store(other.max_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+}
+
+inline void LatencyHistogram::reset()
+{
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+    {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(UINT64_MAX, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+/**
+* Values below SUB_BUCKETS get one bucket each; above that the bucket is
+* chosen by the highest set bit plus the next SUB_BUCKET_BITS bits.
+*/
+inline int LatencyHistogram::bucketIndex(uint64_t ns)
+{
+    if (ns < (uint64_t)SUB_BUCKETS)
+    {
+        return (int)ns;
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - SUB_BUCKET_BITS;
+    int sub = (int)((ns >> shift) & (SUB_BUCKETS - 1));
+    return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+inline uint64_t LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return (uint64_t)index;
+    }
+    int shift = index / SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t)(index % SUB_BUCKETS);
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+/**
+* min and max only need a compare-and-swap when the value extends them, so
+* concurrent recorders rarely retry.
+*/
+inline void LatencyHistogram::record(uint64_t ns)
+{
+    buckets_[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t seen = min_.load(std::memory_order_relaxed);
+    while (ns < seen && !min_.compare_exchange_weak(seen, ns, std::memory_order_relaxed))
+    {
+    }
+    seen = max_.load(std::memory_order_relaxed);
+    while (ns > seen && !max_.compare_exchange_weak(seen, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+inline uint64_t LatencyHistogram::count() const
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+inline uint64_t LatencyHistogram::min() const
+{
+    return count() ? min_.load(std::memory_order_relaxed) : 0;
+}
+
+inline uint64_t LatencyHistogram::max() const
+{
+    return max_.load(std::memory_order_relaxed);
+}
+
+inline double LatencyHistogram::mean() const
+{
+    uint64_t n = count();
+    return n ? (double)sum_.load(std::memory_order_relaxed) / n : 0.0;
+}
+
+inline uint64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t n = count();
+    if (n == 0)
+    {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(p * n + 0.5);
+    if (target == 0) target = 1;
+    uint64_t highest = max();
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            uint64_t bound = bucketUpperBound(i);
+            return bound < highest ? bound : highest;
+        }
+    }
+    return highest;
+}
+
+inline void LatencyHistogram::print(std::ostream& os) const
+{
+    os << "count=" << count()
+       << " mean_ns=" << (uint64_t)mean()
+       << " p50_ns=" << percentile(0.50)
+       << " p90_ns=" << percentile(0.90)
+       << " p99_ns=" << percentile(0.99)
+       << " p999_ns=" << percentile(0.999)
+       << " p9999_ns=" << percentile(0.9999)
+       << " max_ns=" << max();
+}
+
+/**
+* The tree operations that can be timed.
+*/
+enum TreeOp
+{
+    OP_INSERT,
+    OP_FIND,
+    OP_REMOVE,
+    OP_CLEAR,
+    NUM_TREE_OPS
+};
+
+inline const char* treeOpName(TreeOp op)
+{
+    static const char* names[NUM_TREE_OPS] = { "insert", "find", "remove", "clear" };
+    return names[op];
+}
+
+/**
+* One histogram per tree operation plus the sampling state. A tree owns one
+* of these only while latency tracking is enabled; 1 in sampleEvery calls
+* of each operation is timed. Finds sample and record too, so the call
+* counters are relaxed atomics like the histograms, and concurrent const
+* lookups may share a recorder.
+*/
+struct LatencyRecorder
+{
+    explicit LatencyRecorder(unsigned sampleEvery) :
+        sampleEvery(sampleEvery ? sampleEvery : 1)
+    {
+        for (int i = 0; i < NUM_TREE_OPS; ++i) calls[i].store(0, std::memory_order_relaxed);
+    }
+
+    bool shouldSample(TreeOp op)
+    {
+        return calls[op].fetch_add(1, std::memory_order_relaxed) % sampleEvery == 0;
+    }
+
+    unsigned sampleEvery;
+    std::atomic<uint64_t> calls[NUM_TREE_OPS];
+    LatencyHistogram histograms[NUM_TREE_OPS];
+};
+
+/**
+* Times the enclosing scope into the recorder's histogram for op, if a
+* recorder is installed and this call is sampled. With no recorder the
+* cost is a single null check.
+*/
+class LatencyTimer
+{
+public:
+    LatencyTimer(LatencyRecorder* recorder, TreeOp op) :
+        recorder_(NULL), op_(op)
+    {
+        if (recorder && recorder->shouldSample(op))
+        {
+            recorder_ = recorder;
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~LatencyTimer()
+    {
+        if (recorder_)
+        {
+            std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start_;
+            recorder_->histograms[op_].record(
+                (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+private:
+    LatencyRecorder* recorder_;
+    TreeOp op_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef BST_LAYOUT_H
+#define BST_LAYOUT_H
+
+#include <cstddef>
+#include <new>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+* Customization point for the node layout: specialize it with
+* outOfLine = true for a Value that is large and rarely read during
+* lookups. The trees then keep each node's item in a separate value arena
+* and only a copy of the key next to the links, so a descent touches
+* compact key+link nodes, packed densely on the heap, and never drags
+* value bytes into cache; the value costs one extra pointer hop when it is
+* actually read.
+*
+*   struct Record { char payload[512]; };
+*   template <> struct ColdValue<Record> { static const bool outOfLine = true; };
+*
+* Applies to every tree built on Node (BinarySearchTree, AVLTree and the
+* trees derived from them); CompactAVLTree and RcuAVLTree keep their own
+* nodes.
+*/
+template <typename Value>
+struct ColdValue
+{
+    static const bool outOfLine = false;
+};
+
+/**
+* The value arena: fixed-size slots for one item type, carved from 64 KB
+* chunks. There is one arena per item type, shared by every tree (a node
+* cannot see its tree, and node handles move nodes between trees), but
+* each thread allocates from and frees into a cache of its own without
+* locking. The lock is only taken to move a batch of slots between a cache
+* and the shared free list: to refill an empty cache, to flush one that
+* has grown past two batches, in trim(), and when the thread exits.
+*
+* Once every slot is back on the shared free list, no item of the type
+* exists anywhere and the chunks are handed back to the heap. A tree calls
+* trim() from clear() and its destructor, so emptying the last tree of a
+* type returns its memory, unless other threads still cache slots.
+*/
+template <typename T>
+class ColdArena
+{
+    union Slot
+    {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    // A thread's private free list. Trivially destructible, so it stays
+    // usable while the thread's other thread_local objects (trees among
+    // them) are destroyed; closed is set once it has been flushed for
+    // good, after which slots go straight to the shared list.
+    struct Cache
+    {
+        Slot* free;
+        size_t count;
+        bool closed;
+    };
+
+    struct CacheFlusher
+    {
+        Cache* cache;
+        ~CacheFlusher()
+        {
+            instance().flush(*cache, cache->count);
+            cache->closed = true;
+        }
+    };
+
+public:
+    static const size_t SLOT_BYTES = sizeof(Slot);
+
+    static ColdArena& instance()
+    {
+        // never destroyed, so trees with static storage can still free
+        static ColdArena* arena = new ColdArena;
+        return *arena;
+    }
+
+    void* allocate()
+    {
+        Cache& cache = threadCache();
+        if (!cache.free)
+        {
+            refill(cache);
+        }
+        Slot* slot = cache.free;
+        cache.free = slot->next;
+        --cache.count;
+        return slot;
+    }
+
+    void release(void* p)
+    {
+        Cache& cache = threadCache();
+        Slot* slot = static_cast<Slot*>(p);
+        slot->next = cache.free;
+        cache.free = slot;
+        ++cache.count;
+        if (cache.closed || cache.count > 2 * BATCH)
+        {
+            flush(cache, cache.closed ? cache.count : BATCH);
+        }
+    }
+
+    /**
+    * Hands the calling thread's cached slots back, then frees every chunk
+    * if no slot is in use or cached anywhere.
+    */
+    void trim()
+    {
+        Cache& cache = threadCache();
+        flush(cache, cache.count);
+    }
+
+private:
+    static const size_t SLOTS_PER_CHUNK = sizeof(Slot) < 65536 ? 65536 / sizeof(Slot) : 1;
+    static const size_t BATCH = 32;
+
+    ColdArena() : free_(NULL), used_(0), outside_(0) {}
+
+    static Cache& threadCache()
+    {
+        static thread_local Cache cache = { NULL, 0, false };
+        static thread_local CacheFlusher flusher = { &cache };
+        (void)flusher;
+        return cache;
+    }
+
+    /**
+    * Moves a batch of slots into an empty cache, from the shared free list
+    * while it lasts and then from the current chunk.
+    */
+    void refill(Cache& cache)
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        size_t wanted = cache.closed ? 1 : BATCH;
+        for (size_t i = 0; i < wanted; ++i)
+        {
+            Slot* slot = free_;
+            if (slot)
+            {
+                free_ = slot->next;
+            }
+            else
+            {
+                if (chunks_.empty() || used_ == SLOTS_PER_CHUNK)
+                {
+                    chunks_.reserve(chunks_.size() + 1);
+                    chunks_.push_back(static_cast<Slot*>(::operator new(SLOTS_PER_CHUNK * sizeof(Slot))));
+                    used_ = 0;
+                }
+                slot = &chunks_.back()[used_++];
+            }
+            slot->next = cache.free;
+            cache.free = slot;
+            ++cache.count;
+            ++outside_;
+        }
+    }
+
+    /**
+    * Moves up to count slots from the cache to the shared free list, and
+    * frees the chunks if that brought every slot back.
+    */
+    void flush(Cache& cache, size_t count)
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        for (size_t i = 0; i < count && cache.free; ++i)
+        {
+            Slot* slot = cache.free;
+            cache.free = slot->next;
+            --cache.count;
+            slot->next = free_;
+            free_ = slot;
+            --outside_;
+        }
+        if (!outside_ && !chunks_.empty())
+        {
+            for (size_t i = 0; i < chunks_.size(); ++i)
+            {
+                ::operator delete(chunks_[i]);
+            }
+            chunks_.clear();
+            free_ = NULL;
+            used_ = 0;
+        }
+    }
+
+    std::mutex lock_;
+    Slot* free_;
+    std::vector<Slot*> chunks_;
+    size_t used_;     // slots handed out from chunks_.back()
+    size_t outside_;  // slots in thread caches or holding items
+};
+
+/**
+* How a node holds its item. The default keeps the pair inside the node.
+*/
+template <typename Key, typename Value, bool OutOfLine = ColdValue<Value>::outOfLine>
+class NodeItem
+{
+public:
+    // bytes held outside the node, and how many copies of the key there are
+    static const size_t outOfLineBytes = 0;
+    static const size_t keyCopies = 1;
+
+    NodeItem(const Key& key, const Value& value) : item_(key, value) {}
+
+    // returns unused out-of-line storage to the heap where possible
+    static void trim() {}
+
+    const Key& key() const { return item_.first; }
+    const std::pair<const Key, Value>& item() const { return item_; }
+    std::pair<const Key, Value>& item() { return item_; }
+
+private:
+    std::pair<const Key, Value> item_;
+};
+
+/**
+* The out-of-line layout: the pair lives in the value arena and the node
+* keeps a copy of the key for comparisons, so getItem() still hands out a
+* real std::pair and iterators work unchanged.
+*/
+template <typename Key, typename Value>
+class NodeItem<Key, Value, true>
+{
+public:
+    typedef std::pair<const Key, Value> Item;
+    typedef ColdArena<Item> Arena;
+
+    static const size_t outOfLineBytes = Arena::SLOT_BYTES;
+    static const size_t keyCopies = 2;
+
+    NodeItem(const Key& key, const Value& value) : key_(key), item_(NULL)
+    {
+        void* slot = Arena::instance().allocate();
+        try
+        {
+            item_ = new (slot) Item(key, value);
+        }
+        catch (...)
+        {
+            Arena::instance().release(slot);
+            throw;
+        }
+    }
+
+    ~NodeItem()
+    {
+        item_->~Item();
+        Arena::instance().release(item_);
+    }
+
+    static void trim() { Arena::instance().trim(); }
+
+    const Key& key() const { return key_; }
+    const Item& item() const { return *item_; }
+    Item& item() { return *item_; }
+
+private:
+    NodeItem(const NodeItem&);
+    NodeItem& operator=(const NodeItem&);
+
+    Key key_;
+    Item* item_;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef BST_MEMORY_H
+#define BST_MEMORY_H
+
+#include <iostream>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+
+/**
+* Customization point for memoryUsage(): reports the heap bytes owned by a
+* key or value, not counting sizeof(T) itself (that is part of the node).
+* Specialize it for your own types that own heap memory. When dynamic is
+* false the trees skip the per-item walk entirely.
+*/
+template <typename T>
+struct HeapUsage
+{
+    static const bool dynamic = false;
+    static size_t bytes(const T&) { return 0; }
+};
+
+template <typename CharT, typename Traits, typename Alloc>
+struct HeapUsage<std::basic_string<CharT, Traits, Alloc> >
+{
+    static const bool dynamic = true;
+    static size_t bytes(const std::basic_string<CharT, Traits, Alloc>& s)
+    {
+        // short strings live inside the object itself
+        const char* obj = reinterpret_cast<const char*>(&s);
+        const char* data = reinterpret_cast<const char*>(s.data());
+        if (data >= obj && data < obj + sizeof(s))
+        {
+            return 0;
+        }
+        return (s.capacity() + 1) * sizeof(CharT);
+    }
+};
+
+template <typename T, typename Alloc>
+struct HeapUsage<std::vector<T, Alloc> >
+{
+    static const bool dynamic = true;
+    static size_t bytes(const std::vector<T, Alloc>& v)
+    {
+        size_t total = v.capacity() * sizeof(T);
+        if (HeapUsage<T>::dynamic)
+        {
+            for (size_t i = 0; i < v.size(); ++i)
+            {
+                total += HeapUsage<T>::bytes(v[i]);
+            }
+        }
+        return total;
+    }
+};
+
+template <typename A, typename B>
+struct HeapUsage<std::pair<A, B> >
+{
+    static const bool dynamic = HeapUsage<A>::dynamic || HeapUsage<B>::dynamic;
+    static size_t bytes(const std::pair<A, B>& p)
+    {
+        return HeapUsage<A>::bytes(p.first) + HeapUsage<B>::bytes(p.second);
+    }
+};
+
+/**
+* Estimates the bytes malloc really reserves for a request of the given size:
+* glibc on 64-bit rounds request + 8 bytes of header up to a multiple of 16,
+* with a 32 byte minimum chunk.
+*/
+inline size_t mallocChunkSize(size_t request)
+{
+    size_t chunk = (request + sizeof(size_t) + 15) & ~(size_t)15;
+    return chunk < 32 ? 32 : chunk;
+}
+
+/**
+* The memory used by one tree, as returned by memoryUsage().
+*/
+struct MemoryUsage
+{
+    size_t nodes;              // number of nodes
+    size_t nodeBytes;          // nodes * sizeof(node)
+    size_t allocatorOverhead;  // malloc headers and rounding for the nodes
+    size_t keyValueHeapBytes;  // heap memory owned by the keys and values
+    size_t treeBytes;          // the tree object and its auxiliary structures
+
+    MemoryUsage() :
+        nodes(0), nodeBytes(0), allocatorOverhead(0), keyValueHeapBytes(0), treeBytes(0)
+    {
+
+    }
+
+    size_t total() const
+    {
+        return nodeBytes + allocatorOverhead + keyValueHeapBytes + treeBytes;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const MemoryUsage& m)
+{
+    os << "nodes=" << m.nodes
+       << " node_bytes=" << m.nodeBytes
+       << " allocator_overhead=" << m.allocatorOverhead
+       << " key_value_heap_bytes=" << m.keyValueHeapBytes
+       << " tree_bytes=" << m.treeBytes
+       << " total=" << m.total();
+    return os;
+}
+
+/**
+* Fills in the per-node parts of a MemoryUsage for count nodes of nodeSize
+* bytes each.
+*/
+inline void addNodeMemory(MemoryUsage& usage, size_t count, size_t nodeSize)
+{
+    usage.nodes += count;
+    usage.nodeBytes += count * nodeSize;
+    usage.allocatorOverhead += count * (mallocChunkSize(nodeSize) - nodeSize);
+}
+
+#endif
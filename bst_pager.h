@@ -0,0 +1,490 @@
+#ifndef BST_PAGER_H
+#define BST_PAGER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <new>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+* Fixed-size pages of a local file, cached by a buffer pool. This is the
+* storage layer of PagedBTree (paged_bst.h); it knows nothing about what
+* the pages hold.
+*/
+
+typedef uint32_t PageId;
+
+const size_t PAGE_SIZE = 4096;
+
+/**
+* Buffer pool counters. hits + misses is the number of page fetches;
+* misses are the fetches that had to read the file.
+*/
+struct PagerStats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t evictions;
+
+    PagerStats() :
+        hits(0), misses(0), reads(0), writes(0), evictions(0)
+    {
+
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const PagerStats& s)
+{
+    os << "hits=" << s.hits << " misses=" << s.misses << " reads=" << s.reads
+       << " writes=" << s.writes << " evictions=" << s.evictions;
+    return os;
+}
+
+/**
+* A file of PAGE_SIZE pages, read and written with pread/pwrite. Pages are
+* numbered from 0; allocate() hands out the next number and the file
+* grows when that page is first written. I/O errors throw
+* std::runtime_error.
+*/
+class PageFile
+{
+public:
+    explicit PageFile(const std::string& path);
+    ~PageFile();
+
+    size_t pages() const;
+    PageId allocate();
+    void read(PageId id, char* buffer) const;
+    void write(PageId id, const char* buffer);
+    void truncate(size_t pages);
+    void sync();
+
+private:
+    PageFile(const PageFile&) = delete;
+    PageFile& operator=(const PageFile&) = delete;
+
+    void fail(const char* what) const;
+
+    std::string path_;
+    int fd_;
+    size_t pages_;
+};
+
+/*
+  ---------------------------------------------
+  Begin implementations for the PageFile class.
+  ---------------------------------------------
+*/
+
+/**
+* Opens path, creating it if it does not exist.
+*/
+inline PageFile::PageFile(const std::string& path) :
+    path_(path), fd_(-1), pages_(0)
+{
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0)
+    {
+        fail("open");
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) != 0)
+    {
+        int err = errno;
+        ::close(fd_);
+        errno = err;
+        fail("stat");
+    }
+    pages_ = (size_t)st.st_size / PAGE_SIZE;
+}
+
+inline PageFile::~PageFile()
+{
+    ::close(fd_);
+}
+
+inline size_t PageFile::pages() const
+{
+    return pages_;
+}
+
+inline PageId PageFile::allocate()
+{
+    return (PageId)pages_++;
+}
+
+inline void PageFile::read(PageId id, char* buffer) const
+{
+    if (::pread(fd_, buffer, PAGE_SIZE, (off_t)id * PAGE_SIZE) != (ssize_t)PAGE_SIZE)
+    {
+        fail("read");
+    }
+}
+
+inline void PageFile::write(PageId id, const char* buffer)
+{
+    if (::pwrite(fd_, buffer, PAGE_SIZE, (off_t)id * PAGE_SIZE) != (ssize_t)PAGE_SIZE)
+    {
+        fail("write");
+    }
+}
+
+inline void PageFile::truncate(size_t pages)
+{
+    if (::ftruncate(fd_, (off_t)(pages * PAGE_SIZE)) != 0)
+    {
+        fail("truncate");
+    }
+    pages_ = pages;
+}
+
+inline void PageFile::sync()
+{
+    if (::fdatasync(fd_) != 0)
+    {
+        fail("sync");
+    }
+}
+
+inline void PageFile::fail(const char* what) const
+{
+    throw std::runtime_error(path_ + ": " + what + ": " + std::strerror(errno));
+}
+
+/*
+  -------------------------------------------
+  End implementations for the PageFile class.
+  -------------------------------------------
+*/
+
+/**
+* A fixed number of page frames over a PageFile, replaced with the CLOCK
+* algorithm: every fetch sets the frame's reference bit, and the clock
+* hand evicts the first unpinned frame whose bit is clear, clearing bits
+* as it passes. Dirty frames are written back when evicted or flushed.
+*
+* fetch and create return a PageRef, which pins the frame for as long as
+* it (or a copy) lives; pinned frames are never evicted, so the bytes
+* behind a PageRef stay put. Running out of unpinned frames throws
+* std::runtime_error. Not thread-safe.
+*/
+class BufferPool
+{
+public:
+    class PageRef
+    {
+    public:
+        PageRef();
+        PageRef(const PageRef& other);
+        PageRef(PageRef&& other);
+        PageRef& operator=(PageRef other);
+        ~PageRef();
+
+        PageId id() const;
+        char* data() const;
+        void markDirty() const;
+        explicit operator bool() const;
+
+    protected:
+        friend class BufferPool;
+        PageRef(BufferPool* pool, size_t frame);
+
+        BufferPool* pool_;
+        size_t frame_;
+    };
+
+    BufferPool(PageFile& file, size_t frames);
+    ~BufferPool();
+
+    PageRef fetch(PageId id);
+    PageRef create();
+    void flush();
+    void discard();
+
+    size_t frames() const;
+    PagerStats stats() const;
+
+private:
+    struct Frame
+    {
+        PageId id;
+        uint32_t pins;
+        bool used;
+        bool dirty;
+        bool referenced;
+    };
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    size_t victim();
+    void writeBack(Frame& frame, size_t index);
+    char* frameData(size_t index) const;
+
+    PageFile& file_;
+    std::vector<Frame> frames_;
+    char* memory_;  // frames_.size() pages, page aligned
+    std::unordered_map<PageId, size_t> table_;
+    size_t hand_;
+    PagerStats stats_;
+};
+
+/*
+  --------------------------------------------------------
+  Begin implementations for the BufferPool::PageRef class.
+  --------------------------------------------------------
+*/
+
+inline BufferPool::PageRef::PageRef() :
+    pool_(NULL), frame_(0)
+{
+
+}
+
+inline BufferPool::PageRef::PageRef(BufferPool* pool, size_t frame) :
+    pool_(pool), frame_(frame)
+{
+    ++pool_->frames_[frame_].pins;
+}
+
+inline BufferPool::PageRef::PageRef(const PageRef& other) :
+    pool_(other.pool_), frame_(other.frame_)
+{
+    if (pool_)
+    {
+        ++pool_->frames_[frame_].pins;
+    }
+}
+
+inline BufferPool::PageRef::PageRef(PageRef&& other) :
+    pool_(other.pool_), frame_(other.frame_)
+{
+    other.pool_ = NULL;
+}
+
+inline BufferPool::PageRef& BufferPool::PageRef::operator=(PageRef other)
+{
+    std::swap(pool_, other.pool_);
+    std::swap(frame_, other.frame_);
+    return *this;
+}
+
+inline BufferPool::PageRef::~PageRef()
+{
+    if (pool_)
+    {
+        --pool_->frames_[frame_].pins;
+    }
+}
+
+inline PageId BufferPool::PageRef::id() const
+{
+    return pool_->frames_[frame_].id;
+}
+
+inline char* BufferPool::PageRef::data() const
+{
+    return pool_->frameData(frame_);
+}
+
+inline void BufferPool::PageRef::markDirty() const
+{
+    pool_->frames_[frame_].dirty = true;
+}
+
+inline BufferPool::PageRef::operator bool() const
+{
+    return pool_ != NULL;
+}
+
+/*
+  ------------------------------------------------------
+  End implementations for the BufferPool::PageRef class.
+  ------------------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the BufferPool class.
+  -----------------------------------------------
+*/
+
+inline BufferPool::BufferPool(PageFile& file, size_t frames) :
+    file_(file), frames_(frames), memory_(NULL), hand_(0)
+{
+    if (frames == 0)
+    {
+        throw std::invalid_argument("BufferPool needs at least one frame");
+    }
+    memory_ = static_cast<char*>(std::aligned_alloc(PAGE_SIZE, frames * PAGE_SIZE));
+    if (!memory_)
+    {
+        throw std::bad_alloc();
+    }
+    for (size_t i = 0; i < frames_.size(); ++i)
+    {
+        frames_[i] = Frame{0, 0, false, false, false};
+    }
+}
+
+/**
+* Writes back dirty pages; errors are swallowed here, so call flush()
+* first to see them.
+*/
+inline BufferPool::~BufferPool()
+{
+    try
+    {
+        flush();
+    }
+    catch (const std::exception&)
+    {
+    }
+    std::free(memory_);
+}
+
+/**
+* Pins page id, reading it from the file unless it is already cached.
+*/
+inline BufferPool::PageRef BufferPool::fetch(PageId id)
+{
+    std::unordered_map<PageId, size_t>::iterator it = table_.find(id);
+    if (it != table_.end())
+    {
+        ++stats_.hits;
+        frames_[it->second].referenced = true;
+        return PageRef(this, it->second);
+    }
+    ++stats_.misses;
+    size_t index = victim();
+    file_.read(id, frameData(index));
+    ++stats_.reads;
+    frames_[index] = Frame{id, 0, true, false, true};
+    table_[id] = index;
+    return PageRef(this, index);
+}
+
+/**
+* Allocates a new page at the end of the file and pins it, zero filled
+* and dirty.
+*/
+inline BufferPool::PageRef BufferPool::create()
+{
+    size_t index = victim();
+    PageId id = file_.allocate();
+    std::memset(frameData(index), 0, PAGE_SIZE);
+    frames_[index] = Frame{id, 0, true, true, true};
+    table_[id] = index;
+    return PageRef(this, index);
+}
+
+/**
+* Writes every dirty page back and syncs the file.
+*/
+inline void BufferPool::flush()
+{
+    for (size_t i = 0; i < frames_.size(); ++i)
+    {
+        if (frames_[i].used && frames_[i].dirty)
+        {
+            writeBack(frames_[i], i);
+        }
+    }
+    file_.sync();
+}
+
+/**
+* Drops every cached page without writing it back; no page may be pinned.
+*/
+inline void BufferPool::discard()
+{
+    for (size_t i = 0; i < frames_.size(); ++i)
+    {
+        if (frames_[i].pins)
+        {
+            throw std::logic_error("BufferPool::discard with pinned pages");
+        }
+        frames_[i] = Frame{0, 0, false, false, false};
+    }
+    table_.clear();
+    hand_ = 0;
+}
+
+inline size_t BufferPool::frames() const
+{
+    return frames_.size();
+}
+
+inline PagerStats BufferPool::stats() const
+{
+    return stats_;
+}
+
+/**
+* The CLOCK sweep: a free frame, or the first unpinned frame the hand
+* finds with its reference bit clear. Two full turns clear every bit, so
+* failing after that means every frame is pinned.
+*/
+inline size_t BufferPool::victim()
+{
+    for (size_t step = 0; step < 2 * frames_.size(); ++step)
+    {
+        size_t index = hand_;
+        hand_ = (hand_ + 1) % frames_.size();
+        Frame& frame = frames_[index];
+        if (!frame.used)
+        {
+            return index;
+        }
+        if (frame.pins)
+        {
+            continue;
+        }
+        if (frame.referenced)
+        {
+            frame.referenced = false;
+            continue;
+        }
+        if (frame.dirty)
+        {
+            writeBack(frame, index);
+        }
+        table_.erase(frame.id);
+        frame.used = false;
+        ++stats_.evictions;
+        return index;
+    }
+    throw std::runtime_error("BufferPool: every frame is pinned");
+}
+
+inline void BufferPool::writeBack(Frame& frame, size_t index)
+{
+    file_.write(frame.id, frameData(index));
+    frame.dirty = false;
+    ++stats_.writes;
+}
+
+inline char* BufferPool::frameData(size_t index) const
+{
+    return memory_ + index * PAGE_SIZE;
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the BufferPool class.
+  ---------------------------------------------
+*/
+
+#endif
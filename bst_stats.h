@@ -0,0 +1,120 @@
+#ifndef BST_STATS_H
+#define BST_STATS_H
+
+#include <iostream>
+#include <cstdint>
+#include <atomic>
+
+/**
+* A snapshot of the work done by a search tree: how many operations ran and
+* how many key comparisons, node visits, rotations and rebalancing retrace
+* steps they cost in total. Divide by the operation counts for per-operation
+* cost.
+*
+* Counting is compiled in only when BST_STATS is defined (e.g. DEFS=-DBST_STATS
+* in the Makefile). Otherwise the trees carry no counters at all and stats()
+* always returns zeros.
+*/
+struct TreeStats
+{
+    uint64_t inserts;
+    uint64_t finds;
+    uint64_t removes;
+    uint64_t comparisons;
+    uint64_t nodeVisits;
+    uint64_t rotateLefts;
+    uint64_t rotateRights;
+    uint64_t insertFixSteps;
+    uint64_t removeFixSteps;
+
+    TreeStats() :
+        inserts(0), finds(0), removes(0), comparisons(0), nodeVisits(0),
+        rotateLefts(0), rotateRights(0), insertFixSteps(0), removeFixSteps(0)
+    {
+
+    }
+};
+
+/**
+* The live counters a tree keeps under BST_STATS. Const lookups count too,
+* and several threads may run them on one tree at once (ShardedAVLTree::find
+* and UpdatePipeline::read do), so every counter is a relaxed atomic. A
+* snapshot taken while operations run is not consistent across counters.
+*/
+struct TreeCounters
+{
+    std::atomic<uint64_t> inserts;
+    std::atomic<uint64_t> finds;
+    std::atomic<uint64_t> removes;
+    std::atomic<uint64_t> comparisons;
+    std::atomic<uint64_t> nodeVisits;
+    std::atomic<uint64_t> rotateLefts;
+    std::atomic<uint64_t> rotateRights;
+    std::atomic<uint64_t> insertFixSteps;
+    std::atomic<uint64_t> removeFixSteps;
+
+    TreeCounters()
+    {
+        reset();
+    }
+
+    TreeStats snapshot() const
+    {
+        TreeStats s;
+        s.inserts = inserts.load(std::memory_order_relaxed);
+        s.finds = finds.load(std::memory_order_relaxed);
+        s.removes = removes.load(std::memory_order_relaxed);
+        s.comparisons = comparisons.load(std::memory_order_relaxed);
+        s.nodeVisits = nodeVisits.load(std::memory_order_relaxed);
+        s.rotateLefts = rotateLefts.load(std::memory_order_relaxed);
+        s.rotateRights = rotateRights.load(std::memory_order_relaxed);
+        s.insertFixSteps = insertFixSteps.load(std::memory_order_relaxed);
+        s.removeFixSteps = removeFixSteps.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void reset()
+    {
+        inserts.store(0, std::memory_order_relaxed);
+        finds.store(0, std::memory_order_relaxed);
+        removes.store(0, std::memory_order_relaxed);
+        comparisons.store(0, std::memory_order_relaxed);
+        nodeVisits.store(0, std::memory_order_relaxed);
+        rotateLefts.store(0, std::memory_order_relaxed);
+        rotateRights.store(0, std::memory_order_relaxed);
+        insertFixSteps.store(0, std::memory_order_relaxed);
+        removeFixSteps.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    TreeCounters(const TreeCounters&) = delete;
+    TreeCounters& operator=(const TreeCounters&) = delete;
+};
+
+/**
+* Prints the counters as space separated name=value pairs, one snapshot per
+* line, which is easy to scrape into a metrics system.
+*/
+inline std::ostream& operator<<(std::ostream& os, const TreeStats& s)
+{
+    os << "inserts=" << s.inserts
+       << " finds=" << s.finds
+       << " removes=" << s.removes
+       << " comparisons=" << s.comparisons
+       << " node_visits=" << s.nodeVisits
+       << " rotate_lefts=" << s.rotateLefts
+       << " rotate_rights=" << s.rotateRights
+       << " insert_fix_steps=" << s.insertFixSteps
+       << " remove_fix_steps=" << s.removeFixSteps;
+    return os;
+}
+
+// Adds n to one counter of the tree whose member function is running.
+// Compiles to nothing unless BST_STATS is defined.
+#ifdef BST_STATS
+#define BST_COUNT(field, n) (this->stats_.field.fetch_add((n), std::memory_order_relaxed))
+#else
+#define BST_COUNT(field, n) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,166 @@
+// Benchmark for out-of-line values (ColdValue in bst_layout.h).
+//
+// For values of 8, 64, 256 and 1024 bytes, builds an AVLTree of --items
+// items twice, once with the value inside the node and once with it out
+// of line, then times --finds random lookups two ways: "find" only checks
+// that the key is there, so it measures the descent alone, and
+// "find-read" also reads the first word of the value. One CSV line per
+// tree and op:
+//
+//   ./cold-bench --items 1000000 --finds 1000000
+//
+// The inline layout gets slower as the value grows, since every node on
+// the path is spread over more cache lines; the out-of-line one stays
+// flat for "find" and pays one extra cache miss for "find-read".
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include "avlbst.h"
+
+using namespace std;
+
+typedef uint64_t BenchKey;
+
+/**
+* A value of Bytes bytes.
+*/
+template <size_t Bytes>
+struct Payload
+{
+    uint64_t words[Bytes / sizeof(uint64_t)];
+
+    explicit Payload(uint64_t seed = 0)
+    {
+        for (size_t i = 0; i < Bytes / sizeof(uint64_t); ++i)
+        {
+            words[i] = seed + i;
+        }
+    }
+};
+
+template <size_t Bytes>
+ostream& operator<<(ostream& os, const Payload<Bytes>& p)
+{
+    return os << p.words[0];
+}
+
+/**
+* The same value, kept out of line.
+*/
+template <size_t Bytes>
+struct ColdPayload : Payload<Bytes>
+{
+    explicit ColdPayload(uint64_t seed = 0) : Payload<Bytes>(seed) {}
+};
+
+template <size_t Bytes>
+struct ColdValue<ColdPayload<Bytes> >
+{
+    static const bool outOfLine = true;
+};
+
+// Spreads 0..n-1 over the 64-bit key space without collisions, so item i
+// can be looked up again without remembering the keys.
+static BenchKey scramble(uint64_t rank)
+{
+    return rank * 0x9E3779B97F4A7C15ULL;
+}
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void printResult(const string& layout, size_t valueBytes, const string& op, size_t ops,
+                        double seconds, const MemoryUsage& memory, uint64_t checksum)
+{
+    cout << layout << "," << valueBytes << "," << op << "," << ops << "," << seconds * 1e9 / ops << ","
+         << memory.nodeBytes / memory.nodes << "," << memory.total() / memory.nodes << ","
+         << checksum << endl;
+}
+
+template <typename Value>
+void runLayout(const string& layout, size_t items, size_t finds, uint64_t seed)
+{
+    AVLTree<BenchKey, Value> tree;
+    for (size_t i = 0; i < items; ++i)
+    {
+        tree.insert(make_pair(scramble(i), Value(i)));
+    }
+    MemoryUsage memory = tree.memoryUsage();
+
+    mt19937_64 rng(seed);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint64_t hits = 0;
+    for (size_t i = 0; i < finds; ++i)
+    {
+        hits += tree.find(scramble(rng() % items)) != tree.end();
+    }
+    printResult(layout, sizeof(Value), "find", finds, secondsSince(start), memory, hits);
+
+    rng.seed(seed);
+    start = chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < finds; ++i)
+    {
+        typename AVLTree<BenchKey, Value>::iterator it = tree.find(scramble(rng() % items));
+        if (it != tree.end())
+        {
+            sum += it->second.words[0];
+        }
+    }
+    printResult(layout, sizeof(Value), "find-read", finds, secondsSince(start), memory, sum);
+}
+
+template <size_t Bytes>
+void runSize(size_t items, size_t finds, uint64_t seed)
+{
+    runLayout<Payload<Bytes> >("inline", items, finds, seed);
+    runLayout<ColdPayload<Bytes> >("out-of-line", items, finds, seed);
+}
+
+static void usage(const char* prog)
+{
+    cerr << "usage: " << prog << " [--items N] [--finds N] [--seed N]" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t items = 200000;
+    size_t finds = 1000000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        string val = argv[++i];
+        if (arg == "--items") items = strtoull(val.c_str(), NULL, 10);
+        else if (arg == "--finds") finds = strtoull(val.c_str(), NULL, 10);
+        else if (arg == "--seed") seed = strtoull(val.c_str(), NULL, 10);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (items == 0 || finds == 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    cout << "layout,value_bytes,op,ops,ns_per_op,node_bytes,bytes_per_item,checksum" << endl;
+    runSize<8>(items, finds, seed);
+    runSize<64>(items, finds, seed);
+    runSize<256>(items, finds, seed);
+    runSize<1024>(items, finds, seed);
+    return 0;
+}
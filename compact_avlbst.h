@@ -0,0 +1,755 @@
+#ifndef COMPACT_AVLBST_H
+#define COMPACT_AVLBST_H
+
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include "bst_compare.h"
+#include "bst_stats.h"
+#include "bst_memory.h"
+
+// Upper bound on the height of a CompactAVLTree. An AVL tree of height 64
+// needs more than 10^13 nodes, so a fixed-size path never overflows in practice.
+#define COMPACT_MAX_HEIGHT 64
+
+/**
+* A node for the parent-pointer-free AVL tree. Unlike Node/AVLNode it has no
+* parent pointer and no virtual functions, so it is 16 bytes smaller than an
+* AVLNode holding the same item. All upward movement is done with a
+* root-to-node path kept by the tree operations and the iterator.
+*/
+template <typename Key, typename Value>
+class CompactAVLNode
+{
+public:
+    CompactAVLNode(const Key& key, const Value& value);
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+    const Value& getValue() const;
+    Value& getValue();
+
+    CompactAVLNode<Key, Value>* getLeft() const;
+    CompactAVLNode<Key, Value>* getRight() const;
+    int8_t getBalance() const;
+
+    void setLeft(CompactAVLNode<Key, Value>* left);
+    void setRight(CompactAVLNode<Key, Value>* right);
+    void setBalance(int8_t balance);
+    void setValue(const Value& value);
+
+protected:
+    std::pair<const Key, Value> item_;
+    CompactAVLNode<Key, Value>* left_;
+    CompactAVLNode<Key, Value>* right_;
+    int8_t balance_;
+};
+
+/*
+  --------------------------------------------------
+  Begin implementations for the CompactAVLNode class.
+  --------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(const Key& key, const Value& value) :
+    item_(key, value),
+    left_(NULL),
+    right_(NULL),
+    balance_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+const std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<typename Key, typename Value>
+std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem()
+{
+    return item_;
+}
+
+template<typename Key, typename Value>
+const Key& CompactAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<typename Key, typename Value>
+const Value& CompactAVLNode<Key, Value>::getValue() const
+{
+    return item_.second;
+}
+
+template<typename Key, typename Value>
+Value& CompactAVLNode<Key, Value>::getValue()
+{
+    return item_.second;
+}
+
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>* CompactAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>* CompactAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+template<typename Key, typename Value>
+int8_t CompactAVLNode<Key, Value>::getBalance() const
+{
+    return balance_;
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setLeft(CompactAVLNode<Key, Value>* left)
+{
+    left_ = left;
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setRight(CompactAVLNode<Key, Value>* right)
+{
+    right_ = right;
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    balance_ = balance;
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setValue(const Value& value)
+{
+    item_.second = value;
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the CompactAVLNode class.
+  ------------------------------------------------
+*/
+
+/**
+* An AVL tree that does not store parent pointers. It offers the same map
+* interface as AVLTree, except for iterator invalidation (see iterator);
+* insert and remove remember the descent path and retrace along it, and
+* iterators carry their own root-to-node path.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class CompactAVLTree
+{
+public:
+    explicit CompactAVLTree(const Compare& compare = Compare());
+    ~CompactAVLTree();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    size_t size() const;
+    MemoryUsage memoryUsage() const;
+    TreeStats stats() const;
+    void resetStats();
+
+    /**
+    * An in-order iterator. The path from the root to the current node is
+    * stored inline, so advancing never needs a parent pointer and never
+    * allocates. That makes an iterator about 520 bytes, so pass it by
+    * reference where it matters.
+    *
+    * Because the stored path describes the tree's shape, any insert or
+    * remove (both may rotate) invalidates every iterator into the tree,
+    * not just iterators to the removed node as with AVLTree. Changing a
+    * value through an iterator or operator[] keeps them valid.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class CompactAVLTree<Key, Value, Compare>;
+        void push(CompactAVLNode<Key, Value>* node);
+        void pushLeftSpine(CompactAVLNode<Key, Value>* node);
+        CompactAVLNode<Key, Value>* current() const;
+
+        CompactAVLNode<Key, Value>* path_[COMPACT_MAX_HEIGHT];
+        int depth_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    CompactAVLNode<Key, Value>* internalFind(const Key& key) const;
+    void replaceChild(CompactAVLNode<Key, Value>** path, int8_t* dirs, int index,
+                      CompactAVLNode<Key, Value>* child);
+    CompactAVLNode<Key, Value>* rotateLeft(CompactAVLNode<Key, Value>* node);
+    CompactAVLNode<Key, Value>* rotateRight(CompactAVLNode<Key, Value>* node);
+    CompactAVLNode<Key, Value>* rebalance(CompactAVLNode<Key, Value>* node);
+    int heightIfBalanced(const CompactAVLNode<Key, Value>* root) const;
+    void destroyTree(CompactAVLNode<Key, Value>* root);
+
+protected:
+    CompactAVLNode<Key, Value>* root_;
+    size_t size_;
+    Compare compare_;
+#ifdef BST_STATS
+    mutable TreeCounters stats_;
+#endif
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the CompactAVLTree::iterator class.
+--------------------------------------------------------------
+*/
+
+/**
+* A default constructor that makes the end iterator (an empty path).
+*/
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator() :
+    depth_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+std::pair<const Key,Value> &
+CompactAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return current()->getItem();
+}
+
+template<class Key, class Value, class Compare>
+std::pair<const Key,Value> *
+CompactAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(current()->getItem());
+}
+
+template<class Key, class Value, class Compare>
+bool
+CompactAVLTree<Key, Value, Compare>::iterator::operator==(
+    const CompactAVLTree<Key, Value, Compare>::iterator& rhs) const
+{
+    return current() == rhs.current();
+}
+
+template<class Key, class Value, class Compare>
+bool
+CompactAVLTree<Key, Value, Compare>::iterator::operator!=(
+    const CompactAVLTree<Key, Value, Compare>::iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances to the in-order successor: either the leftmost node of the right
+* subtree, or the nearest ancestor on the path that we reached from its left.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator&
+CompactAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    CompactAVLNode<Key, Value>* node = current();
+    if (node->getRight())
+    {
+        pushLeftSpine(node->getRight());
+    }
+    else
+    {
+        --depth_;
+        while (depth_ > 0 && path_[depth_ - 1]->getRight() == node)
+        {
+            node = path_[depth_ - 1];
+            --depth_;
+        }
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::iterator::push(CompactAVLNode<Key, Value>* node)
+{
+    path_[depth_++] = node;
+}
+
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::iterator::pushLeftSpine(CompactAVLNode<Key, Value>* node)
+{
+    while (node)
+    {
+        push(node);
+        node = node->getLeft();
+    }
+}
+
+template<class Key, class Value, class Compare>
+CompactAVLNode<Key, Value>* CompactAVLTree<Key, Value, Compare>::iterator::current() const
+{
+    return depth_ == 0 ? NULL : path_[depth_ - 1];
+}
+
+/*
+------------------------------------------------------------
+End implementations for the CompactAVLTree::iterator class.
+------------------------------------------------------------
+*/
+
+/*
+---------------------------------------------------
+Begin implementations for the CompactAVLTree class.
+---------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(const Compare& compare) :
+    root_(NULL),
+    size_(0),
+    compare_(compare)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::~CompactAVLTree()
+{
+    clear();
+}
+
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<class Key, class Value, class Compare>
+size_t CompactAVLTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* Reports node, allocator, key/value heap and tree object bytes; see
+* BinarySearchTree::memoryUsage.
+*/
+template<class Key, class Value, class Compare>
+MemoryUsage CompactAVLTree<Key, Value, Compare>::memoryUsage() const
+{
+    MemoryUsage usage;
+    addNodeMemory(usage, size_, sizeof(CompactAVLNode<Key, Value>));
+    usage.treeBytes = sizeof(*this);
+
+    if (HeapUsage<Key>::dynamic || HeapUsage<Value>::dynamic)
+    {
+        for (iterator it = begin(); it != end(); ++it)
+        {
+            usage.keyValueHeapBytes += HeapUsage<Key>::bytes(it->first) +
+                                       HeapUsage<Value>::bytes(it->second);
+        }
+    }
+    return usage;
+}
+
+template<class Key, class Value, class Compare>
+TreeStats CompactAVLTree<Key, Value, Compare>::stats() const
+{
+#ifdef BST_STATS
+    return stats_.snapshot();
+#else
+    return TreeStats();
+#endif
+}
+
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::resetStats()
+{
+#ifdef BST_STATS
+    stats_.reset();
+#endif
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::begin() const
+{
+    iterator it;
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if the key
+* does not exist. The descent path becomes the iterator's path.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    BST_COUNT(finds, 1);
+    iterator it;
+    CompactAVLNode<Key, Value>* curr = root_;
+    while (curr)
+    {
+        BST_COUNT(nodeVisits, 1);
+        BST_COUNT(comparisons, 1);
+        it.push(curr);
+        int cmp = KeyComparator<Compare>::compare(compare_, key, curr->getKey());
+        if (cmp == 0)
+        {
+            return it;
+        }
+        curr = (cmp < 0) ? curr->getLeft() : curr->getRight();
+    }
+    return end();
+}
+
+template<class Key, class Value, class Compare>
+Value& CompactAVLTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    BST_COUNT(finds, 1);
+    CompactAVLNode<Key, Value>* curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+template<class Key, class Value, class Compare>
+Value const & CompactAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    BST_COUNT(finds, 1);
+    CompactAVLNode<Key, Value>* curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+template<class Key, class Value, class Compare>
+CompactAVLNode<Key, Value>* CompactAVLTree<Key, Value, Compare>::internalFind(const Key& key) const
+{
+    CompactAVLNode<Key, Value>* curr = root_;
+    while (curr)
+    {
+        BST_COUNT(nodeVisits, 1);
+        BST_COUNT(comparisons, 1);
+        int cmp = KeyComparator<Compare>::compare(compare_, key, curr->getKey());
+        if (cmp == 0)
+        {
+            break;
+        }
+        curr = (cmp < 0) ? curr->getLeft() : curr->getRight();
+    }
+    return curr;
+}
+
+/**
+* Inserts the pair, overwriting the value if the key already exists.
+* The balance factors are retraced along the recorded descent path and
+* at most one (single or double) rotation is done.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    BST_COUNT(inserts, 1);
+    const Key& insertKey = keyValuePair.first;
+    CompactAVLNode<Key, Value>* path[COMPACT_MAX_HEIGHT];
+    int8_t dirs[COMPACT_MAX_HEIGHT];
+    int depth = 0;
+
+    CompactAVLNode<Key, Value>* current = root_;
+    while (current)
+    {
+        BST_COUNT(nodeVisits, 1);
+        BST_COUNT(comparisons, 1);
+        int cmp = KeyComparator<Compare>::compare(compare_, insertKey, current->getKey());
+        if (cmp == 0)
+        {
+            current->setValue(keyValuePair.second);
+            return;
+        }
+        path[depth] = current;
+        dirs[depth] = (cmp < 0) ? -1 : 1;
+        current = (dirs[depth] < 0) ? current->getLeft() : current->getRight();
+        ++depth;
+    }
+
+    CompactAVLNode<Key, Value>* grown =
+        new CompactAVLNode<Key, Value>(insertKey, keyValuePair.second);
+    ++size_;
+    replaceChild(path, dirs, depth, grown);
+
+    // walk back up: the subtree on side dirs[i] of path[i] just got taller
+    for (int i = depth - 1; i >= 0; --i)
+    {
+        BST_COUNT(insertFixSteps, 1);
+        CompactAVLNode<Key, Value>* node = path[i];
+        node->setBalance(node->getBalance() + dirs[i]);
+        if (node->getBalance() == 0)
+        {
+            return;
+        }
+        else if (node->getBalance() == 2 || node->getBalance() == -2)
+        {
+            replaceChild(path, dirs, i, rebalance(node));
+            return;
+        }
+    }
+}
+
+/**
+* Removes the key if present. A node with two children is replaced by its
+* predecessor, then the balance factors are retraced along the path.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    CompactAVLNode<Key, Value>* path[COMPACT_MAX_HEIGHT];
+    int8_t dirs[COMPACT_MAX_HEIGHT];
+    int depth = 0;
+
+    BST_COUNT(removes, 1);
+    CompactAVLNode<Key, Value>* toRemove = root_;
+    while (toRemove)
+    {
+        BST_COUNT(nodeVisits, 1);
+        BST_COUNT(comparisons, 1);
+        int cmp = KeyComparator<Compare>::compare(compare_, key, toRemove->getKey());
+        if (cmp == 0)
+        {
+            break;
+        }
+        path[depth] = toRemove;
+        dirs[depth] = (cmp < 0) ? -1 : 1;
+        toRemove = (dirs[depth] < 0) ? toRemove->getLeft() : toRemove->getRight();
+        ++depth;
+    }
+
+    if (!toRemove)
+    {
+        // node is not in tree
+        return;
+    }
+
+    if (toRemove->getLeft() && toRemove->getRight())
+    {
+        // 2 child case - the predecessor takes toRemove's place
+        int removeDepth = depth;
+        path[depth] = toRemove;
+        dirs[depth] = -1;
+        ++depth;
+
+        CompactAVLNode<Key, Value>* pred = toRemove->getLeft();
+        while (pred->getRight())
+        {
+            path[depth] = pred;
+            dirs[depth] = 1;
+            ++depth;
+            pred = pred->getRight();
+        }
+
+        // unlink pred, then move it into toRemove's position
+        replaceChild(path, dirs, depth, pred->getLeft());
+        pred->setLeft(toRemove->getLeft());
+        pred->setRight(toRemove->getRight());
+        pred->setBalance(toRemove->getBalance());
+        replaceChild(path, dirs, removeDepth, pred);
+        path[removeDepth] = pred;
+    }
+    else
+    {
+        CompactAVLNode<Key, Value>* child =
+            toRemove->getLeft() ? toRemove->getLeft() : toRemove->getRight();
+        replaceChild(path, dirs, depth, child);
+    }
+
+    delete toRemove;
+    --size_;
+
+    // walk back up: the subtree on side dirs[i] of path[i] just got shorter
+    for (int i = depth - 1; i >= 0; --i)
+    {
+        BST_COUNT(removeFixSteps, 1);
+        CompactAVLNode<Key, Value>* node = path[i];
+        node->setBalance(node->getBalance() - dirs[i]);
+        if (node->getBalance() == 1 || node->getBalance() == -1)
+        {
+            return;
+        }
+        else if (node->getBalance() != 0)
+        {
+            node = rebalance(node);
+            replaceChild(path, dirs, i, node);
+            if (node->getBalance() != 0)
+            {
+                // single rotation around a balanced child keeps the height
+                return;
+            }
+        }
+    }
+}
+
+/**
+* Makes child the subtree found at path[index], i.e. the child of
+* path[index - 1] on side dirs[index - 1], or the root when index is 0.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::replaceChild(CompactAVLNode<Key, Value>** path, int8_t* dirs,
+                                              int index, CompactAVLNode<Key, Value>* child)
+{
+    if (index == 0)
+    {
+        root_ = child;
+    }
+    else if (dirs[index - 1] < 0)
+    {
+        path[index - 1]->setLeft(child);
+    }
+    else
+    {
+        path[index - 1]->setRight(child);
+    }
+}
+
+/**
+* Rotates the subtree left and returns its new root. The balance factors
+* (right height minus left height) are updated for any starting balances.
+*/
+template<class Key, class Value, class Compare>
+CompactAVLNode<Key, Value>* CompactAVLTree<Key, Value, Compare>::rotateLeft(CompactAVLNode<Key, Value>* node)
+{
+    BST_COUNT(rotateLefts, 1);
+    CompactAVLNode<Key, Value>* child = node->getRight();
+    node->setRight(child->getLeft());
+    child->setLeft(node);
+
+    node->setBalance(node->getBalance() - 1 - std::max<int8_t>(child->getBalance(), 0));
+    child->setBalance(child->getBalance() - 1 + std::min<int8_t>(node->getBalance(), 0));
+    return child;
+}
+
+template<class Key, class Value, class Compare>
+CompactAVLNode<Key, Value>* CompactAVLTree<Key, Value, Compare>::rotateRight(CompactAVLNode<Key, Value>* node)
+{
+    BST_COUNT(rotateRights, 1);
+    CompactAVLNode<Key, Value>* child = node->getLeft();
+    node->setLeft(child->getRight());
+    child->setRight(node);
+
+    node->setBalance(node->getBalance() + 1 - std::min<int8_t>(child->getBalance(), 0));
+    child->setBalance(child->getBalance() + 1 + std::max<int8_t>(node->getBalance(), 0));
+    return child;
+}
+
+/**
+* Fixes a node whose balance is +/-2 with a single or double rotation and
+* returns the new root of its subtree.
+*/
+template<class Key, class Value, class Compare>
+CompactAVLNode<Key, Value>* CompactAVLTree<Key, Value, Compare>::rebalance(CompactAVLNode<Key, Value>* node)
+{
+    if (node->getBalance() < 0)
+    {
+        if (node->getLeft()->getBalance() > 0)
+        {
+            // zig-zag
+            node->setLeft(rotateLeft(node->getLeft()));
+        }
+        return rotateRight(node);
+    }
+    else
+    {
+        if (node->getRight()->getBalance() < 0)
+        {
+            node->setRight(rotateRight(node->getRight()));
+        }
+        return rotateLeft(node);
+    }
+}
+
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::clear()
+{
+    destroyTree(root_);
+    root_ = NULL;
+    size_ = 0;
+}
+
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::destroyTree(CompactAVLNode<Key, Value>* root)
+{
+    if (!root)
+    {
+        return;
+    }
+
+    destroyTree(root->getLeft());
+    destroyTree(root->getRight());
+    delete root;
+}
+
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    return heightIfBalanced(root_) != -1;
+}
+
+/**
+* Returns the height of the subtree, or -1 if any node in it is unbalanced.
+*/
+template<class Key, class Value, class Compare>
+int CompactAVLTree<Key, Value, Compare>::heightIfBalanced(const CompactAVLNode<Key, Value>* root) const
+{
+    if (!root)
+    {
+        return 0;
+    }
+
+    int left = heightIfBalanced(root->getLeft());
+    int right = heightIfBalanced(root->getRight());
+    if (left == -1 || right == -1 || std::abs(left - right) > 1)
+    {
+        return -1;
+    }
+    return 1 + std::max(left, right);
+}
+
+/*
+-------------------------------------------------
+End implementations for the CompactAVLTree class.
+-------------------------------------------------
+*/
+
+#endif
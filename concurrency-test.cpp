@@ -0,0 +1,605 @@
+// Multi-threaded stress tests for the concurrent wrappers. Built with
+// ThreadSanitizer by `make concurrency-test`, so data races are reported
+// as well as the failed checks below. Exits non-zero if any check fails.
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+#include "avlbst.h"
+#include "update_pipeline.h"
+#include "sharded_avlbst.h"
+#include "rcu_avlbst.h"
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                             \
+    do                                                                          \
+    {                                                                           \
+        if (!(cond))                                                            \
+        {                                                                       \
+            cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << endl; \
+            ++failures;                                                         \
+        }                                                                       \
+    } while (0)
+
+// True if the tree iterates in strictly increasing key order and holds
+// exactly size() items.
+template<typename Tree>
+static bool inOrder(const Tree& tree)
+{
+    size_t count = 0;
+    bool first = true;
+    typename Tree::iterator prev;
+    for (typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++count)
+    {
+        if (!first && !(prev->first < it->first))
+        {
+            return false;
+        }
+        prev = it;
+        first = false;
+    }
+    return count == tree.size();
+}
+
+template<typename Tree>
+static bool sameContents(const Tree& tree, const map<int, int>& expected)
+{
+    if (tree.size() != expected.size())
+    {
+        return false;
+    }
+    map<int, int>::const_iterator want = expected.begin();
+    for (typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+    {
+        if (it->first != want->first || it->second != want->second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+  ------------------------------------
+  Read-path bookkeeping
+  ------------------------------------
+*/
+
+// Const lookups write the operation counters and the latency recorder, so
+// readers sharing a tree must not race on them and no count may be lost.
+static void testConcurrentLookupCounters()
+{
+    const int READERS = 4;
+    const int LOOKUPS = 20000;
+    const unsigned SAMPLE_EVERY = 4;
+
+    AVLTree<int, int> tree;
+    for (int k = 0; k < 1000; ++k)
+    {
+        tree.insert(make_pair(k, k));
+    }
+    tree.resetStats();
+    tree.enableLatencyTracking(SAMPLE_EVERY);
+    const AVLTree<int, int>& shared = tree;
+
+    atomic<int> misses(0);
+    vector<thread> readers;
+    for (int r = 0; r < READERS; ++r)
+    {
+        readers.push_back(thread([&, r] {
+            for (int i = 0; i < LOOKUPS; ++i)
+            {
+                int key = (i * 7 + r) % 1000;
+                AVLTree<int, int>::iterator it = shared.find(key);
+                if (it == shared.end() || it->second != key)
+                {
+                    ++misses;
+                }
+            }
+        }));
+    }
+    for (size_t r = 0; r < readers.size(); ++r)
+    {
+        readers[r].join();
+    }
+
+    const uint64_t total = (uint64_t)READERS * LOOKUPS;
+    CHECK(misses.load() == 0);
+    CHECK(tree.latency(OP_FIND)->count() == total / SAMPLE_EVERY);
+#ifdef BST_STATS
+    CHECK(tree.stats().finds == total);
+#endif
+}
+
+/*
+  ------------------------------------
+  UpdatePipeline
+  ------------------------------------
+*/
+
+// Producers write disjoint key ranges, each key many times, while a reader
+// checks the tree between batches. Every producer knows the final state of
+// its own keys (updates to one key apply in push order), so the union of
+// their reference maps is the expected tree. Every so often a producer
+// syncs and checks that its latest write is visible.
+static void testPipelineProducers()
+{
+    const int PRODUCERS = 4;
+    const int KEYS_PER_PRODUCER = 64;
+    const int UPDATES = 20000;
+
+    UpdatePipeline<int, int> pipeline;
+    vector<map<int, int> > expected(PRODUCERS);
+    atomic<int> syncFailures(0);
+    atomic<bool> done(false);
+    atomic<int> readerFailures(0);
+
+    thread reader([&] {
+        while (!done.load())
+        {
+            bool ok = pipeline.read([](const AVLTree<int, int>& t) { return inOrder(t) && t.isBalanced(); });
+            if (!ok)
+            {
+                ++readerFailures;
+            }
+        }
+    });
+
+    vector<thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p)
+    {
+        producers.push_back(thread([&, p] {
+            map<int, int>& mine = expected[p];
+            unsigned seed = 12345u + p;
+            for (int i = 0; i < UPDATES; ++i)
+            {
+                seed = seed * 1103515245u + 12345u;
+                int key = p * KEYS_PER_PRODUCER + (int)((seed >> 16) % KEYS_PER_PRODUCER);
+                if ((seed >> 8) % 5 == 0)
+                {
+                    pipeline.remove(key);
+                    mine.erase(key);
+                }
+                else
+                {
+                    pipeline.insert(key, i);
+                    mine[key] = i;
+                }
+                if (i % 1000 == 999)
+                {
+                    pipeline.insert(key, -i);
+                    mine[key] = -i;
+                    pipeline.sync();
+                    int seen = pipeline.read([key](const AVLTree<int, int>& t) {
+                        AVLTree<int, int>::iterator it = t.find(key);
+                        return it == t.end() ? 0 : it->second;
+                    });
+                    if (seen != -i)
+                    {
+                        ++syncFailures;
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t p = 0; p < producers.size(); ++p)
+    {
+        producers[p].join();
+    }
+    pipeline.sync();
+    done.store(true);
+    reader.join();
+
+    map<int, int> all;
+    for (int p = 0; p < PRODUCERS; ++p)
+    {
+        all.insert(expected[p].begin(), expected[p].end());
+    }
+    CHECK(syncFailures.load() == 0);
+    CHECK(readerFailures.load() == 0);
+    CHECK(pipeline.read([&all](const AVLTree<int, int>& t) { return sameContents(t, all); }));
+    PipelineStats stats = pipeline.stats();
+    CHECK(stats.updates == (uint64_t)PRODUCERS * (UPDATES + UPDATES / 1000));
+    CHECK(stats.treeOps <= stats.updates);
+}
+
+// Updates pushed while a reader holds the tree pile up into one batch, so
+// repeated keys must fold into fewer tree operations, the last write to
+// each key winning.
+static void testPipelineFolding()
+{
+    const int KEYS = 10;
+    const int UPDATES = 1000;
+
+    UpdatePipeline<int, int> pipeline;
+    map<int, int> expected;
+    pipeline.read([&](const AVLTree<int, int>&) {
+        for (int i = 0; i < UPDATES; ++i)
+        {
+            int key = i % KEYS;
+            if (i % 7 == 3)
+            {
+                pipeline.remove(key);
+                expected.erase(key);
+            }
+            else
+            {
+                pipeline.insert(key, i);
+                expected[key] = i;
+            }
+        }
+        return 0;
+    });
+    pipeline.sync();
+
+    CHECK(pipeline.read([&expected](const AVLTree<int, int>& t) { return sameContents(t, expected); }));
+    PipelineStats stats = pipeline.stats();
+    CHECK(stats.updates == (uint64_t)UPDATES);
+    CHECK(stats.treeOps < stats.updates);
+}
+
+/*
+  ------------------------------------
+  ShardedAVLTree
+  ------------------------------------
+*/
+
+// Iterates the whole sharded tree; false unless keys are strictly
+// increasing. count gets the number of items seen.
+static bool shardedInOrder(const ShardedAVLTree<int, int>& tree, size_t& count)
+{
+    count = 0;
+    int prev = 0;
+    for (ShardedAVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it, ++count)
+    {
+        if (count && prev >= it->first)
+        {
+            return false;
+        }
+        prev = it->first;
+    }
+    return true;
+}
+
+// Writers own the keys congruent to their id, skewed towards the last
+// shard so that rebalance() has ranges to move, and check through find()
+// that their own latest writes are visible while ranges move under them.
+// A rebalancer and an iterating reader run throughout.
+static void testShardedWriters()
+{
+    const int WRITERS = 4;
+    const int KEYS = 4000;
+    const int UPDATES = 20000;
+
+    vector<int> boundaries;
+    boundaries.push_back(100);
+    boundaries.push_back(200);
+    boundaries.push_back(300);
+    ShardedAVLTree<int, int> tree(boundaries);
+    vector<map<int, int> > expected(WRITERS);
+    atomic<bool> done(false);
+    atomic<int> findFailures(0);
+    atomic<int> orderFailures(0);
+
+    vector<thread> writers;
+    for (int w = 0; w < WRITERS; ++w)
+    {
+        writers.push_back(thread([&, w] {
+            map<int, int>& mine = expected[w];
+            unsigned seed = 777u + w;
+            for (int i = 0; i < UPDATES; ++i)
+            {
+                seed = seed * 1103515245u + 12345u;
+                int key = (int)((seed >> 12) % (KEYS / WRITERS)) * WRITERS + w;
+                if ((seed >> 4) % 4 == 0)
+                {
+                    tree.remove(key);
+                    mine.erase(key);
+                }
+                else
+                {
+                    tree.insert(make_pair(key, i));
+                    mine[key] = i;
+                }
+                int value = 0;
+                bool found = tree.find(key, value);
+                map<int, int>::const_iterator want = mine.find(key);
+                if (found != (want != mine.end()) || (found && value != want->second))
+                {
+                    ++findFailures;
+                }
+            }
+        }));
+    }
+    thread rebalancer([&] {
+        while (!done.load())
+        {
+            tree.rebalance(0.05);
+        }
+    });
+    thread reader([&] {
+        while (!done.load())
+        {
+            size_t count = 0;
+            if (!shardedInOrder(tree, count))
+            {
+                ++orderFailures;
+            }
+        }
+    });
+
+    for (size_t w = 0; w < writers.size(); ++w)
+    {
+        writers[w].join();
+    }
+    done.store(true);
+    rebalancer.join();
+    reader.join();
+    tree.rebalance(0.05);
+
+    map<int, int> all;
+    for (int w = 0; w < WRITERS; ++w)
+    {
+        all.insert(expected[w].begin(), expected[w].end());
+    }
+    CHECK(findFailures.load() == 0);
+    CHECK(orderFailures.load() == 0);
+    CHECK(tree.size() == all.size());
+    size_t count = 0;
+    CHECK(shardedInOrder(tree, count));
+    CHECK(count == all.size());
+    map<int, int>::const_iterator want = all.begin();
+    bool same = true;
+    for (ShardedAVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+    {
+        same = same && want != all.end() && it->first == want->first && it->second == want->second;
+    }
+    CHECK(same);
+    vector<int> bounds = tree.boundaries();
+    for (size_t i = 1; i < bounds.size(); ++i)
+    {
+        CHECK(bounds[i - 1] < bounds[i]);
+    }
+    // the initial boundaries left nearly everything in the last shard
+    CHECK(tree.shardSize(tree.shards() - 1) < all.size() / 2);
+}
+
+/*
+  ------------------------------------
+  RcuAVLTree
+  ------------------------------------
+*/
+
+// Readers check every snapshot they see while two writers replace values
+// and insert and remove keys: keys strictly increasing, the tree balanced,
+// each value written for its own key, and the keys below PINNED (written
+// before the readers start and never removed) always found. A reader that
+// used a freed node would show up as a TSan report or a bad value.
+static void testRcuReaders()
+{
+    const int READERS = 4;
+    const int WRITERS = 2;
+    const int KEYS = 512;
+    const int PINNED = 16;
+    const int UPDATES = 20000;
+
+    RcuAVLTree<int, int> tree;
+    for (int k = 0; k < PINNED; ++k)
+    {
+        tree.insert(make_pair(k, k));
+    }
+    vector<map<int, int> > expected(WRITERS);
+    atomic<bool> done(false);
+    atomic<int> readerFailures(0);
+    atomic<long> snapshots(0);
+
+    vector<thread> readers;
+    for (int r = 0; r < READERS; ++r)
+    {
+        readers.push_back(thread([&] {
+            while (!done.load())
+            {
+                RcuAVLTree<int, int>::ReadGuard guard(tree);
+                bool ok = tree.isBalanced();
+                bool first = true;
+                int prev = 0;
+                for (RcuAVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it)
+                {
+                    ok = ok && (first || prev < it->first) && it->second % KEYS == it->first;
+                    prev = it->first;
+                    first = false;
+                }
+                for (int k = 0; k < PINNED; ++k)
+                {
+                    RcuAVLTree<int, int>::iterator it = tree.find(k);
+                    ok = ok && it != tree.end() && it->first == k && it->second % KEYS == k;
+                }
+                if (!ok)
+                {
+                    ++readerFailures;
+                }
+                ++snapshots;
+            }
+        }));
+    }
+
+    // writer w owns the keys congruent to w, except that both rewrite the
+    // pinned keys; values are key + KEYS * generation
+    vector<thread> writers;
+    for (int w = 0; w < WRITERS; ++w)
+    {
+        writers.push_back(thread([&, w] {
+            map<int, int>& mine = expected[w];
+            unsigned seed = 4242u + w;
+            for (int i = 1; i <= UPDATES; ++i)
+            {
+                seed = seed * 1103515245u + 12345u;
+                int key = (int)((seed >> 12) % (KEYS / WRITERS)) * WRITERS + w;
+                if (key < PINNED)
+                {
+                    tree.insert(make_pair(key, key + KEYS * i));
+                }
+                else if ((seed >> 4) % 3 == 0)
+                {
+                    tree.remove(key);
+                    mine.erase(key);
+                }
+                else
+                {
+                    tree.insert(make_pair(key, key + KEYS * i));
+                    mine[key] = key + KEYS * i;
+                }
+            }
+        }));
+    }
+    for (size_t w = 0; w < writers.size(); ++w)
+    {
+        writers[w].join();
+    }
+    done.store(true);
+    for (size_t r = 0; r < readers.size(); ++r)
+    {
+        readers[r].join();
+    }
+
+    CHECK(readerFailures.load() == 0);
+    CHECK(snapshots.load() > 0);
+    map<int, int> all;
+    for (int w = 0; w < WRITERS; ++w)
+    {
+        all.insert(expected[w].begin(), expected[w].end());
+    }
+    CHECK(tree.size() == all.size() + PINNED);
+    {
+        RcuAVLTree<int, int>::ReadGuard guard(tree);
+        CHECK(tree.isBalanced());
+        size_t count = 0;
+        bool same = true;
+        for (RcuAVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it, ++count)
+        {
+            if (it->first < PINNED)
+            {
+                same = same && it->second % KEYS == it->first;
+            }
+            else
+            {
+                map<int, int>::const_iterator want = all.find(it->first);
+                same = same && want != all.end() && it->second == want->second;
+            }
+        }
+        CHECK(same);
+        CHECK(count == tree.size());
+    }
+
+    // with no readers left, the next reclaim frees everything retired
+    for (int i = 0; i < 64; ++i)
+    {
+        tree.insert(make_pair(0, KEYS * i));
+    }
+    CHECK(tree.retiredNodes() < 64);
+}
+
+// A value whose copies and assignments throw once every failEvery calls
+// while armed.
+struct FlakyValue
+{
+    static int failEvery;
+    static int calls;
+    int v;
+
+    FlakyValue(int x = 0) : v(x) {}
+    FlakyValue(const FlakyValue& other) : v(other.v) { maybeThrow(); }
+    FlakyValue& operator=(const FlakyValue& other)
+    {
+        maybeThrow();
+        v = other.v;
+        return *this;
+    }
+    static void maybeThrow()
+    {
+        if (failEvery && ++calls % failEvery == 0)
+        {
+            throw runtime_error("flaky copy");
+        }
+    }
+};
+int FlakyValue::failEvery = 0;
+int FlakyValue::calls = 0;
+
+ostream& operator<<(ostream& os, const FlakyValue& value)
+{
+    return os << value.v;
+}
+
+// An update that throws part way must leave the published tree as it was
+// and free exactly the nodes it created; run under ASan a double free or
+// leak would also show.
+static void testRcuThrowingUpdates()
+{
+    RcuAVLTree<int, FlakyValue> tree;
+    map<int, int> expected;
+    unsigned seed = 99u;
+    int thrown = 0;
+    for (int i = 0; i < 20000; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        int key = (int)((seed >> 12) % 300);
+        FlakyValue::failEvery = 0;
+        pair<const int, FlakyValue> item(key, FlakyValue(i));
+        FlakyValue::failEvery = 5 + (int)((seed >> 4) % 10);
+        try
+        {
+            if ((seed >> 8) % 3)
+            {
+                tree.insert(item);
+                expected[key] = i;
+            }
+            else
+            {
+                tree.remove(key);
+                expected.erase(key);
+            }
+        }
+        catch (const runtime_error&)
+        {
+            ++thrown;
+        }
+    }
+    FlakyValue::failEvery = 0;
+
+    CHECK(thrown > 0);
+    CHECK(tree.size() == expected.size());
+    RcuAVLTree<int, FlakyValue>::ReadGuard guard(tree);
+    CHECK(tree.isBalanced());
+    bool same = true;
+    map<int, int>::const_iterator want = expected.begin();
+    for (RcuAVLTree<int, FlakyValue>::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+    {
+        same = same && want != expected.end() && it->first == want->first && it->second.v == want->second;
+    }
+    CHECK(same && want == expected.end());
+}
+
+int main()
+{
+    testConcurrentLookupCounters();
+    testPipelineProducers();
+    testPipelineFolding();
+    testShardedWriters();
+    testRcuReaders();
+    testRcuThrowingUpdates();
+
+    if (failures)
+    {
+        cout << failures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << "All concurrency checks passed" << endl;
+    return 0;
+}
@@ -0,0 +1,403 @@
+#ifndef DENSE_MAP_H
+#define DENSE_MAP_H
+
+#include <iostream>
+#include <stdexcept>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "bst_memory.h"
+#include "avlbst.h"
+
+/**
+* Whether keys of type Key come from a domain small enough to index
+* directly: integral types of at most 16 bits, except bool.
+*/
+template <typename Key>
+struct DenseKeyTraits
+{
+    static const bool dense = std::is_integral<Key>::value &&
+                              !std::is_same<Key, bool>::value &&
+                              sizeof(Key) <= 2;
+};
+
+/**
+* A map over a small integral key domain (char, int8_t, uint8_t, int16_t,
+* uint16_t, ...) with the same interface and iterator semantics as
+* BinarySearchTree. Every possible key owns one slot, so insert, find and
+* remove are O(1) with no key comparisons: a presence bitmap records the
+* occupied slots and the items live in a direct-indexed array. Iteration
+* visits keys in increasing order, finding the next occupied slot with a
+* bit scan of the bitmap.
+*
+* The item array holds 2^(8 * sizeof(Key)) slots and is allocated on the
+* first insert, so an empty map costs only its bitmap. Items are
+* constructed when inserted and destroyed when removed.
+*/
+template <typename Key, typename Value>
+class DenseKeyMap
+{
+public:
+    DenseKeyMap();
+    ~DenseKeyMap();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    MemoryUsage memoryUsage() const;
+
+    /**
+    * An in-order iterator: the slot index of the current item, or the
+    * number of slots at the end.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class DenseKeyMap<Key, Value>;
+        iterator(const DenseKeyMap<Key, Value>* map, size_t slot);
+
+        const DenseKeyMap<Key, Value>* map_;
+        size_t slot_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+private:
+    typedef typename std::make_unsigned<Key>::type SlotKey;
+    typedef std::pair<const Key, Value> Item;
+
+    static const size_t SLOTS = (size_t)std::numeric_limits<SlotKey>::max() + 1;
+    static const size_t WORDS = SLOTS / 64;
+
+    DenseKeyMap(const DenseKeyMap&) = delete;
+    DenseKeyMap& operator=(const DenseKeyMap&) = delete;
+
+    static size_t slotOf(const Key& key);
+    bool occupied(size_t slot) const;
+    size_t nextOccupied(size_t slot) const;
+    Item* item(size_t slot) const;
+
+    uint64_t bits_[WORDS];
+    Item* items_;  // SLOTS items, allocated on first insert
+    size_t size_;
+};
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the DenseKeyMap::iterator class.
+  ----------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+DenseKeyMap<Key, Value>::iterator::iterator() :
+    map_(NULL), slot_(SLOTS)
+{
+
+}
+
+template<typename Key, typename Value>
+DenseKeyMap<Key, Value>::iterator::iterator(const DenseKeyMap<Key, Value>* map, size_t slot) :
+    map_(map), slot_(slot)
+{
+
+}
+
+template<typename Key, typename Value>
+std::pair<const Key,Value>& DenseKeyMap<Key, Value>::iterator::operator*() const
+{
+    return *map_->item(slot_);
+}
+
+template<typename Key, typename Value>
+std::pair<const Key,Value>* DenseKeyMap<Key, Value>::iterator::operator->() const
+{
+    return map_->item(slot_);
+}
+
+/**
+* All end iterators compare equal, whichever map they came from, just like
+* the NULL-node end iterator of BinarySearchTree.
+*/
+template<typename Key, typename Value>
+bool DenseKeyMap<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    if (slot_ == SLOTS || rhs.slot_ == SLOTS)
+    {
+        return slot_ == rhs.slot_;
+    }
+    return map_ == rhs.map_ && slot_ == rhs.slot_;
+}
+
+template<typename Key, typename Value>
+bool DenseKeyMap<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Key, typename Value>
+typename DenseKeyMap<Key, Value>::iterator& DenseKeyMap<Key, Value>::iterator::operator++()
+{
+    slot_ = map_->nextOccupied(slot_ + 1);
+    return *this;
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the DenseKeyMap::iterator class.
+  --------------------------------------------------------
+*/
+
+/*
+  -------------------------------------------------
+  Begin implementations for the DenseKeyMap class.
+  -------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+DenseKeyMap<Key, Value>::DenseKeyMap() :
+    items_(NULL), size_(0)
+{
+    for (size_t w = 0; w < WORDS; ++w)
+    {
+        bits_[w] = 0;
+    }
+}
+
+template<typename Key, typename Value>
+DenseKeyMap<Key, Value>::~DenseKeyMap()
+{
+    clear();
+    ::operator delete(items_);
+}
+
+/**
+* Maps a key to its slot. Subtracting the smallest key keeps slots in key
+* order for signed keys too.
+*/
+template<typename Key, typename Value>
+size_t DenseKeyMap<Key, Value>::slotOf(const Key& key)
+{
+    return (SlotKey)((SlotKey)key - (SlotKey)std::numeric_limits<Key>::min());
+}
+
+template<typename Key, typename Value>
+bool DenseKeyMap<Key, Value>::occupied(size_t slot) const
+{
+    return (bits_[slot / 64] >> (slot % 64)) & 1;
+}
+
+/**
+* Returns the first occupied slot at or after slot, or SLOTS if there is none.
+*/
+template<typename Key, typename Value>
+size_t DenseKeyMap<Key, Value>::nextOccupied(size_t slot) const
+{
+    if (slot >= SLOTS)
+    {
+        return SLOTS;
+    }
+    size_t w = slot / 64;
+    uint64_t word = bits_[w] & (~(uint64_t)0 << (slot % 64));
+    while (!word)
+    {
+        if (++w == WORDS)
+        {
+            return SLOTS;
+        }
+        word = bits_[w];
+    }
+    return w * 64 + __builtin_ctzll(word);
+}
+
+template<typename Key, typename Value>
+typename DenseKeyMap<Key, Value>::Item* DenseKeyMap<Key, Value>::item(size_t slot) const
+{
+    return items_ + slot;
+}
+
+/**
+* Inserts the item, or overwrites the value if the key is already present.
+*/
+template<typename Key, typename Value>
+void DenseKeyMap<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    size_t slot = slotOf(keyValuePair.first);
+    if (occupied(slot))
+    {
+        item(slot)->second = keyValuePair.second;
+        return;
+    }
+    if (!items_)
+    {
+        items_ = static_cast<Item*>(::operator new(SLOTS * sizeof(Item)));
+    }
+    new (item(slot)) Item(keyValuePair);
+    bits_[slot / 64] |= (uint64_t)1 << (slot % 64);
+    ++size_;
+}
+
+template<typename Key, typename Value>
+void DenseKeyMap<Key, Value>::remove(const Key& key)
+{
+    size_t slot = slotOf(key);
+    if (!occupied(slot))
+    {
+        return;
+    }
+    item(slot)->~Item();
+    bits_[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+    --size_;
+}
+
+/**
+* Destroys every item. The slot array is kept for reuse.
+*/
+template<typename Key, typename Value>
+void DenseKeyMap<Key, Value>::clear()
+{
+    if (!std::is_trivially_destructible<Item>::value)
+    {
+        for (size_t slot = nextOccupied(0); slot < SLOTS; slot = nextOccupied(slot + 1))
+        {
+            item(slot)->~Item();
+        }
+    }
+    for (size_t w = 0; w < WORDS; ++w)
+    {
+        bits_[w] = 0;
+    }
+    size_ = 0;
+}
+
+template<typename Key, typename Value>
+bool DenseKeyMap<Key, Value>::empty() const
+{
+    return size_ == 0;
+}
+
+template<typename Key, typename Value>
+size_t DenseKeyMap<Key, Value>::size() const
+{
+    return size_;
+}
+
+/**
+* The whole slot array counts as node memory, whether or not a slot is in
+* use; the bitmap is part of the map object.
+*/
+template<typename Key, typename Value>
+MemoryUsage DenseKeyMap<Key, Value>::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.nodes = size_;
+    usage.treeBytes = sizeof(*this);
+    if (items_)
+    {
+        usage.nodeBytes = SLOTS * sizeof(Item);
+        usage.allocatorOverhead = mallocChunkSize(usage.nodeBytes) - usage.nodeBytes;
+    }
+    if (HeapUsage<Key>::dynamic || HeapUsage<Value>::dynamic)
+    {
+        for (iterator it = begin(); it != end(); ++it)
+        {
+            usage.keyValueHeapBytes += HeapUsage<Key>::bytes(it->first) +
+                                       HeapUsage<Value>::bytes(it->second);
+        }
+    }
+    return usage;
+}
+
+template<typename Key, typename Value>
+typename DenseKeyMap<Key, Value>::iterator DenseKeyMap<Key, Value>::begin() const
+{
+    return iterator(this, nextOccupied(0));
+}
+
+template<typename Key, typename Value>
+typename DenseKeyMap<Key, Value>::iterator DenseKeyMap<Key, Value>::end() const
+{
+    return iterator(this, SLOTS);
+}
+
+template<typename Key, typename Value>
+typename DenseKeyMap<Key, Value>::iterator DenseKeyMap<Key, Value>::find(const Key& key) const
+{
+    size_t slot = slotOf(key);
+    return iterator(this, occupied(slot) ? slot : SLOTS);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<typename Key, typename Value>
+Value& DenseKeyMap<Key, Value>::operator[](const Key& key)
+{
+    size_t slot = slotOf(key);
+    if (!occupied(slot)) throw std::out_of_range("Invalid key");
+    return item(slot)->second;
+}
+
+template<typename Key, typename Value>
+Value const & DenseKeyMap<Key, Value>::operator[](const Key& key) const
+{
+    size_t slot = slotOf(key);
+    if (!occupied(slot)) throw std::out_of_range("Invalid key");
+    return item(slot)->second;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the DenseKeyMap class.
+  -----------------------------------------------
+*/
+
+/**
+* Picks the map implementation for a key and value type: DenseKeyMap for
+* small integral keys whose item array (one slot per possible key) stays
+* within MAX_DENSE_BYTES, AVLTree for everything else. The cap keeps e.g.
+* OrderedMap<uint16_t, std::string> from allocating 65536 strings' worth
+* of slots on its first insert; use DenseKeyMap directly to opt in anyway.
+* Both offer insert, remove, find, operator[], clear, size and in-order
+* iterators, e.g.
+*
+*   OrderedMap<char, int> m;       // a DenseKeyMap<char, int>
+*   OrderedMap<int, int> t;        // an AVLTree<int, int>
+*   OrderedMap<uint16_t, int> u;   // 65536 8-byte slots: a DenseKeyMap
+*/
+template <typename Key, typename Value>
+struct OrderedMapFor
+{
+    static const size_t MAX_DENSE_BYTES = 1 << 20;
+
+    static const bool dense = DenseKeyTraits<Key>::dense &&
+                              ((size_t)1 << (8 * sizeof(Key))) * sizeof(std::pair<const Key, Value>) <=
+                                  MAX_DENSE_BYTES;
+
+    typedef typename std::conditional<dense,
+                                      DenseKeyMap<Key, Value>,
+                                      AVLTree<Key, Value> >::type type;
+};
+
+template <typename Key, typename Value>
+using OrderedMap = typename OrderedMapFor<Key, Value>::type;
+
+#endif
@@ -0,0 +1,150 @@
+// Benchmark for equalPaths and equalPathsMany.
+//
+// Builds --trees small trees (perfect trees of --depth levels below the
+// root; every other one has a leaf moved one level down so it fails the
+// check) and times equalPaths over all of them on one thread, then
+// equalPathsMany on --threads threads. A final case checks a single chain
+// of --chain nodes, which a recursive check would overflow the stack on.
+// One CSV line per case:
+//
+//   ./equal-paths-bench --trees 1000000 --depth 3 --threads 4 --chain 10000000
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include "equal-paths.h"
+#include "equal-paths-many.h"
+
+using namespace std;
+
+/**
+* Builds a perfect tree with `depth` levels below the root in nodes,
+* starting at nodes[first]; returns the root. With unequal set, the
+* leftmost leaf gets one extra child.
+*/
+static Node* buildTree(vector<Node>& nodes, size_t first, int depth, bool unequal)
+{
+    size_t count = ((size_t)1 << (depth + 1)) - 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t left = 2 * i + 1;
+        size_t right = 2 * i + 2;
+        nodes[first + i].key = (int)i;
+        nodes[first + i].left = left < count ? &nodes[first + left] : NULL;
+        nodes[first + i].right = right < count ? &nodes[first + right] : NULL;
+    }
+    if (unequal)
+    {
+        size_t leaf = count / 2;
+        nodes[first + leaf].left = &nodes[first + count];
+        nodes[first + count] = Node(-1);
+    }
+    return &nodes[first];
+}
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void printResult(const string& name, size_t trees, unsigned threads, double seconds, size_t equal)
+{
+    cout << name << "," << trees << "," << threads << "," << seconds * 1e9 / trees << "," << equal << endl;
+}
+
+static void usage(const char* prog)
+{
+    cerr << "usage: " << prog << " [--trees N] [--depth N] [--threads N] [--chain N]" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t trees = 1000000;
+    int depth = 3;
+    unsigned threads = thread::hardware_concurrency();
+    size_t chain = 10000000;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        string val = argv[++i];
+        if (arg == "--trees") trees = strtoull(val.c_str(), NULL, 10);
+        else if (arg == "--depth") depth = atoi(val.c_str());
+        else if (arg == "--threads") threads = (unsigned)strtoul(val.c_str(), NULL, 10);
+        else if (arg == "--chain") chain = strtoull(val.c_str(), NULL, 10);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (trees == 0 || depth < 0 || depth > 20)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+
+    // one spare node per tree for the unequal variant
+    size_t perTree = ((size_t)1 << (depth + 1));
+    vector<Node> nodes(trees * perTree, Node(0));
+    vector<Node*> roots(trees);
+    for (size_t t = 0; t < trees; ++t)
+    {
+        roots[t] = buildTree(nodes, t * perTree, depth, t % 2 == 1);
+    }
+
+    cout << "case,trees,threads,ns_per_tree,equal" << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    size_t equal = 0;
+    for (size_t t = 0; t < trees; ++t)
+    {
+        equal += equalPaths(roots[t]);
+    }
+    printResult("sequential", trees, 1, secondsSince(start), equal);
+
+    vector<unsigned> counts;
+    counts.push_back(1);
+    if (threads > 1)
+    {
+        counts.push_back(threads);
+    }
+    bool* results = new bool[trees];
+    for (size_t c = 0; c < counts.size(); ++c)
+    {
+        start = chrono::steady_clock::now();
+        equalPathsMany(roots, results, counts[c]);
+        double seconds = secondsSince(start);
+        equal = 0;
+        for (size_t t = 0; t < trees; ++t)
+        {
+            equal += results[t];
+        }
+        printResult("many", trees, counts[c], seconds, equal);
+    }
+    delete [] results;
+
+    if (chain > 0)
+    {
+        vector<Node> links(chain, Node(0));
+        for (size_t i = 0; i + 1 < chain; ++i)
+        {
+            links[i].left = &links[i + 1];
+        }
+        start = chrono::steady_clock::now();
+        equal = equalPaths(&links[0]);
+        printResult("chain", 1, 1, secondsSince(start), equal);
+    }
+    return 0;
+}
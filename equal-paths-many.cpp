@@ -0,0 +1,23 @@
+#include <algorithm>
+#include "equal-paths-many.h"
+#include "work_stealing.h"
+using namespace std;
+
+// Trees per task: small trees take well under a microsecond each, so a
+// task covers many of them to keep the work-stealing queues off the
+// critical path.
+static const size_t TREES_PER_TASK = 1024;
+
+void equalPathsMany(const vector<Node*>& roots, bool* results, unsigned threads)
+{
+    size_t tasks = (roots.size() + TREES_PER_TASK - 1) / TREES_PER_TASK;
+    WorkStealingRun::run(tasks, threads, [&roots, results](size_t task)
+    {
+        size_t first = task * TREES_PER_TASK;
+        size_t last = min(roots.size(), first + TREES_PER_TASK);
+        for (size_t i = first; i < last; ++i)
+        {
+            results[i] = equalPaths(roots[i]);
+        }
+    });
+}
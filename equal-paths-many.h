@@ -0,0 +1,21 @@
+#ifndef EQUAL_PATHS_MANY_H
+#define EQUAL_PATHS_MANY_H
+#include <vector>
+#include "equal-paths.h"
+
+/**
+ * @brief Runs equalPaths on every tree in roots, in parallel, and stores
+ *        the answer for roots[i] in results[i]
+ *
+ *        The trees are split into chunks that worker threads take and
+ *        steal from each other (see work_stealing.h), so a few large trees
+ *        among many small ones do not leave threads idle.
+ *
+ * @param roots The trees to check; they must not change during the call
+ * @param results Room for roots.size() answers
+ * @param threads Number of threads, counting the caller; 0 means one per
+ *        hardware thread
+ */
+void equalPathsMany(const std::vector<Node*>& roots, bool* results, unsigned threads = 0);
+
+#endif
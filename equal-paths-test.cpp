@@ -78,6 +78,37 @@ void test6(const char* msg)
   cout << msg << ": " << static_cast<bool>(equalPaths(a)) << endl;
 }
 
+void test7(const char* msg)
+{
+  // both subtrees of a are unequal on their own
+  setNode(a,1,b,c);
+  setNode(b,2,d,t);
+  setNode(c,3,v,w);
+  setNode(d,4,NULL,NULL);
+  setNode(t,5,x,NULL);
+  setNode(v,6,NULL,NULL);
+  setNode(w,7,y,NULL);
+  setNode(x,8,NULL,NULL);
+  setNode(y,9,NULL,NULL);
+  cout << msg << ": " << equalPaths(a) << endl;
+}
+
+void test8(const char* msg)
+{
+  // a chain far deeper than a recursive check could handle
+  const int length = 1000000;
+  Node* head = NULL;
+  for(int i = 0; i < length; i++) {
+    head = new Node(i, head);
+  }
+  cout << msg << ": " << equalPaths(head) << endl;
+  while(head) {
+    Node* next = head->left;
+    delete head;
+    head = next;
+  }
+}
+
 int main()
 {
   a = new Node(1);
@@ -99,6 +130,8 @@ int main()
   test5("Test5");
 
   test6("Test6");
+  test7("Test7");
+  test8("Test8");
  
   delete a;
   delete b;
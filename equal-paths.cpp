@@ -1,42 +1,114 @@
+#include <vector>
+#include <cstddef>
 #include "equal-paths.h"
 using namespace std;
 
 
 // You may add any prototypes of helper functions here
-int pathLengths(Node*);
 
-int pathLengths(Node* root)
+/**
+ * A node still to be visited and its distance from the root.
+ */
+struct PathEntry
 {
-    if (!root->left && !root->right)
-    {
-        return 0;
-    }
-    else if (!root->left)
-    {
-        return 1 + pathLengths(root->right);
-    }
-    else if (!root->right)
+    Node* node;
+    size_t depth;
+};
+
+/**
+ * The stack of pending right subtrees. The first INLINE_ENTRIES entries
+ * live inside the object, so checking a tree less than that many levels
+ * deep allocates nothing; deeper trees spill into a vector.
+ */
+class PathStack
+{
+public:
+    PathStack() : size_(0) {}
+
+    bool empty() const
     {
-        return 1 + pathLengths(root->left);
+        return size_ == 0;
     }
-    else
+
+    void push(Node* node, size_t depth)
     {
-        int leftLen = pathLengths(root->left);
-        int rightLen = pathLengths(root->right);
-        if (leftLen == rightLen)
+        PathEntry entry = {node, depth};
+        if (size_ < INLINE_ENTRIES)
         {
-            return 1 + leftLen;
+            inline_[size_] = entry;
         }
         else
         {
-            return -1;
+            spill_.push_back(entry);
         }
+        ++size_;
+    }
+
+    PathEntry pop()
+    {
+        --size_;
+        if (size_ < INLINE_ENTRIES)
+        {
+            return inline_[size_];
+        }
+        PathEntry entry = spill_.back();
+        spill_.pop_back();
+        return entry;
     }
-}
 
+private:
+    static const size_t INLINE_ENTRIES = 64;
+
+    PathEntry inline_[INLINE_ENTRIES];
+    vector<PathEntry> spill_;
+    size_t size_;
+};
+
+/**
+ * Iterative depth-first walk: follow each path down its leftmost branch,
+ * stacking the right subtrees passed on the way. The first leaf fixes the
+ * depth every other leaf must have, and the walk stops at the first leaf
+ * at another depth, or at the first inner node already at that depth
+ * (every leaf below it would be deeper).
+ */
 bool equalPaths(Node * root)
 {
     // Add your code below
-    return static_cast<bool>(pathLengths(root) != -1);
+    if (!root)
+    {
+        return true;
+    }
+    PathStack pending;
+    pending.push(root, 0);
+    bool seenLeaf = false;
+    size_t leafDepth = 0;
+    while (!pending.empty())
+    {
+        PathEntry entry = pending.pop();
+        Node* node = entry.node;
+        size_t depth = entry.depth;
+        while (node->left || node->right)
+        {
+            if (seenLeaf && depth >= leafDepth)
+            {
+                return false;
+            }
+            if (node->left && node->right)
+            {
+                pending.push(node->right, depth + 1);
+            }
+            node = node->left ? node->left : node->right;
+            ++depth;
+        }
+        if (!seenLeaf)
+        {
+            seenLeaf = true;
+            leafDepth = depth;
+        }
+        else if (depth != leafDepth)
+        {
+            return false;
+        }
+    }
+    return true;
 }
-
@@ -0,0 +1,339 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+
+#ifndef EXPORT_BST_H
+#define EXPORT_BST_H
+
+// Streaming Graphviz DOT / JSON export of a tree.
+//
+// Unlike printRoot, which is limited to PPBST_MAX_HEIGHT levels, the
+// exporters visit each emitted node once in pre-order and write it straight
+// to the stream, so their cost is O(emitted nodes) and their memory is one
+// stack entry per level. Two knobs keep huge trees manageable:
+//
+//   maxDepth   - stop below this many levels (0 means no limit)
+//   sampleRate - below fullDepth levels, follow each child edge only with
+//                this probability, giving a random set of root-to-leaf
+//                paths through the lower levels
+//
+// Children that are cut off by either knob are marked as truncated.
+
+/**
+* Options for BinarySearchTree::exportDot/exportJson.
+*/
+struct TreeExportOptions
+{
+    unsigned maxDepth;
+    double sampleRate;
+    unsigned fullDepth;
+    uint64_t seed;
+    bool includeValues;
+
+    TreeExportOptions() :
+        maxDepth(0), sampleRate(1.0), fullDepth(0), seed(1), includeValues(false)
+    {
+
+    }
+};
+
+// Characters are written as strings, other arithmetic types as numbers.
+template<typename T>
+struct ExportAsNumber
+{
+    static const bool value = std::is_arithmetic<T>::value &&
+        !std::is_same<T, char>::value && !std::is_same<T, signed char>::value &&
+        !std::is_same<T, unsigned char>::value;
+};
+
+/**
+* Writes a key or value as a JSON scalar: numbers as they are, everything
+* else as an escaped string written by printBSTValue.
+*/
+template<typename T>
+void exportJsonScalar(std::ostream& os, const T& value,
+                      typename std::enable_if<ExportAsNumber<T>::value>::type* = 0)
+{
+    os << value;
+}
+
+template<typename T>
+void exportJsonScalar(std::ostream& os, const T& value,
+                      typename std::enable_if<!ExportAsNumber<T>::value>::type* = 0)
+{
+    std::ostringstream text;
+    printBSTValue(text, value);
+    const std::string& s = text.str();
+    os << '"';
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        char c = s[i];
+        if (c == '"' || c == '\\')
+        {
+            os << '\\' << c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            static const char hex[] = "0123456789abcdef";
+            os << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+        }
+        else
+        {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+/**
+* Writes a key or value as a DOT label fragment (quotes and backslashes escaped).
+*/
+template<typename T>
+void exportDotLabel(std::ostream& os, const T& value)
+{
+    std::ostringstream text;
+    printBSTValue(text, value);
+    const std::string& s = text.str();
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        if (s[i] == '"' || s[i] == '\\')
+        {
+            os << '\\';
+        }
+        os << s[i];
+    }
+}
+
+/**
+* Fast deterministic generator for the sampling decisions (xorshift64*).
+*/
+class ExportSampler
+{
+public:
+    ExportSampler(const TreeExportOptions& opts) :
+        state_(opts.seed ? opts.seed : 1),
+        threshold_(opts.sampleRate >= 1.0 ? UINT64_MAX :
+                   (uint64_t)(opts.sampleRate * 18446744073709551615.0)),
+        opts_(opts)
+    {
+
+    }
+
+    // Whether to follow a child edge out of a node at the given depth
+    // (the root has depth 1).
+    bool follow(unsigned depth)
+    {
+        if (opts_.maxDepth && depth >= opts_.maxDepth)
+        {
+            return false;
+        }
+        if (depth < opts_.fullDepth || threshold_ == UINT64_MAX)
+        {
+            return true;
+        }
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ULL <= threshold_;
+    }
+
+private:
+    uint64_t state_;
+    uint64_t threshold_;
+    const TreeExportOptions& opts_;
+};
+
+/**
+* A pending node in the pre-order walk of an exporter.
+*/
+template<typename Key, typename Value>
+struct ExportFrame
+{
+    Node<Key, Value>* node;
+    uint64_t parentId;
+    unsigned depth;
+    char side;
+};
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::exportDot(std::ostream& os) const
+{
+    exportDot(os, TreeExportOptions());
+}
+
+/**
+* Writes the tree as a Graphviz digraph. Nodes are labelled with their keys
+* (and values if requested); AVL nodes are shaded by balance factor, and a
+* dashed "..." node marks each child that was not exported. Lazily deleted
+* nodes are still part of the shape and are drawn dashed and greyed out.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::exportDot(std::ostream& os, const TreeExportOptions& opts) const
+{
+    os << "digraph bst {\n  node [shape=box, style=filled, fillcolor=white];\n";
+
+    ExportSampler sampler(opts);
+    std::vector<ExportFrame<Key, Value> > stack;
+    if (root_)
+    {
+        ExportFrame<Key, Value> rootFrame = { root_, 0, 1, ' ' };
+        stack.push_back(rootFrame);
+    }
+
+    uint64_t nextId = 0;
+    while (!stack.empty())
+    {
+        ExportFrame<Key, Value> frame = stack.back();
+        stack.pop_back();
+        uint64_t id = nextId++;
+
+        os << "  n" << id << " [label=\"";
+        exportDotLabel(os, frame.node->getKey());
+        if (opts.includeValues)
+        {
+            os << "\\n";
+            exportDotLabel(os, frame.node->getValue());
+        }
+        os << "\"";
+        if (frame.node->isTombstone())
+        {
+            os << ", style=\"filled,dashed\", fontcolor=gray";
+        }
+        int balance = 0;
+        if (nodeBalance(frame.node, balance) && balance != 0)
+        {
+            os << ", fillcolor=" << (balance < 0 ? "lightblue" : "lightpink")
+               << ", xlabel=\"" << balance << "\"";
+        }
+        os << "];\n";
+        if (frame.depth > 1)
+        {
+            os << "  n" << frame.parentId << " -> n" << id
+               << " [label=\"" << frame.side << "\"];\n";
+        }
+
+        // push right first so the left subtree is written first
+        Node<Key, Value>* children[2] = { frame.node->getRight(), frame.node->getLeft() };
+        const char sides[2] = { 'R', 'L' };
+        for (int i = 0; i < 2; ++i)
+        {
+            if (!children[i])
+            {
+                continue;
+            }
+            if (sampler.follow(frame.depth))
+            {
+                ExportFrame<Key, Value> child = { children[i], id, frame.depth + 1, sides[i] };
+                stack.push_back(child);
+            }
+            else
+            {
+                os << "  n" << id << sides[i] << " [label=\"...\", style=dashed];\n"
+                   << "  n" << id << " -> n" << id << sides[i]
+                   << " [style=dashed, label=\"" << sides[i] << "\"];\n";
+            }
+        }
+    }
+    os << "}\n";
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::exportJson(std::ostream& os) const
+{
+    exportJson(os, TreeExportOptions());
+}
+
+/**
+* Writes the tree as one JSON object with a flat, pre-order "nodes" array:
+*   {"size":N,"tombstones":T,"nodes":[{"id":0,"parent":-1,"side":"",
+*     "depth":1,"key":..,"balance":..,"truncated":""}, ...]}
+* "value" appears only when values are requested (includeValues), and
+* "balance" only when the tree is an AVL tree. "truncated" lists the sides
+* ("L", "R") whose subtrees were cut off by maxDepth or sampling.
+* "size" counts live items only; lazily deleted nodes are exported too,
+* with "tombstone":true, so an untruncated export has size + tombstones
+* nodes.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::exportJson(std::ostream& os, const TreeExportOptions& opts) const
+{
+    os << "{\"size\":" << size() << ",\"tombstones\":" << tombstones_ << ",\"nodes\":[";
+
+    ExportSampler sampler(opts);
+    std::vector<ExportFrame<Key, Value> > stack;
+    if (root_)
+    {
+        ExportFrame<Key, Value> rootFrame = { root_, 0, 1, ' ' };
+        stack.push_back(rootFrame);
+    }
+
+    uint64_t nextId = 0;
+    while (!stack.empty())
+    {
+        ExportFrame<Key, Value> frame = stack.back();
+        stack.pop_back();
+        uint64_t id = nextId++;
+
+        os << (id ? ",\n" : "\n") << "{\"id\":" << id << ",\"parent\":";
+        if (frame.depth > 1)
+        {
+            os << frame.parentId << ",\"side\":\"" << frame.side << "\"";
+        }
+        else
+        {
+            os << "-1,\"side\":\"\"";
+        }
+        os << ",\"depth\":" << frame.depth << ",\"key\":";
+        exportJsonScalar(os, frame.node->getKey());
+        if (opts.includeValues)
+        {
+            os << ",\"value\":";
+            exportJsonScalar(os, frame.node->getValue());
+        }
+        int balance = 0;
+        if (nodeBalance(frame.node, balance))
+        {
+            os << ",\"balance\":" << balance;
+        }
+        if (frame.node->isTombstone())
+        {
+            os << ",\"tombstone\":true";
+        }
+
+        std::string truncated;
+        Node<Key, Value>* children[2] = { frame.node->getRight(), frame.node->getLeft() };
+        const char sides[2] = { 'R', 'L' };
+        for (int i = 0; i < 2; ++i)
+        {
+            if (!children[i])
+            {
+                continue;
+            }
+            if (sampler.follow(frame.depth))
+            {
+                ExportFrame<Key, Value> child = { children[i], id, frame.depth + 1, sides[i] };
+                stack.push_back(child);
+            }
+            else
+            {
+                truncated.insert(truncated.begin(), sides[i]);
+            }
+        }
+        os << ",\"truncated\":\"" << truncated << "\"}";
+    }
+    os << "\n]}\n";
+}
+
+/**
+* Plain BST nodes carry no balance factor.
+*/
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::nodeBalance(const Node<Key, Value>* node, int& balance) const
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,431 @@
+#ifndef FROZEN_MAP_H
+#define FROZEN_MAP_H
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include "bst_memory.h"
+
+/**
+* An immutable, compressed copy of an ordered map with integer keys, built
+* in O(n) from any container iterated in key order (an AVLTree, a
+* BinarySearchTree, a std::map, ...).
+*
+* Keys are split into blocks of BLOCK_SIZE. A small directory holds each
+* block's first key; the rest of the block is stored as the gaps between
+* consecutive keys, minus the block's smallest gap (frame of reference),
+* bit-packed at the width of the block's largest remainder. Dense or
+* evenly spaced keys take a few bits each. Values are stored unchanged in
+* one array, in key order.
+*
+* find and lower_bound binary search the directory, then decode one block
+* up to the key; iteration decodes one gap per step. All of them are
+* const, allocate nothing and are safe to call from several threads.
+*/
+template <typename Key, typename Value>
+class FrozenIntMap
+{
+    static_assert(std::is_integral<Key>::value, "FrozenIntMap needs integer keys");
+
+public:
+    static const size_t BLOCK_SIZE = 128;
+
+    FrozenIntMap();
+    template<typename Container>
+    explicit FrozenIntMap(const Container& items);
+
+    /**
+    * An in-order iterator: the item's position and its decoded key. Keys
+    * are not stored as such, so items are returned by value.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value> operator*() const;
+        Key key() const;
+        const Value& value() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class FrozenIntMap<Key, Value>;
+        iterator(const FrozenIntMap<Key, Value>* map, size_t index, uint64_t bits);
+
+        const FrozenIntMap<Key, Value>* map_;
+        size_t index_;  // size() at the end
+        uint64_t bits_;  // the key, in the order-preserving unsigned form
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+
+    bool empty() const;
+    size_t size() const;
+    MemoryUsage memoryUsage() const;
+
+private:
+    struct Block
+    {
+        uint64_t minGap;
+        uint64_t bitOffset;  // where the block's packed gaps start in words_
+        uint8_t width;
+    };
+
+    static uint64_t toBits(const Key& key);
+    static Key fromBits(uint64_t bits);
+    static unsigned bitWidth(uint64_t value);
+
+    uint64_t readBits(uint64_t bitPos, unsigned width) const;
+    void appendBits(uint64_t value, unsigned width, uint64_t& bitPos);
+    void packBlock(const uint64_t* keys, size_t count, uint64_t& bitPos);
+    uint64_t nextBits(size_t index, uint64_t bits) const;
+
+    std::vector<uint64_t> firstKeys_;  // per block, for the binary search
+    std::vector<Block> blocks_;
+    std::vector<uint64_t> words_;  // packed gaps, plus one padding word
+    std::vector<Value> values_;
+};
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the FrozenIntMap::iterator class.
+  -----------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+FrozenIntMap<Key, Value>::iterator::iterator() :
+    map_(NULL), index_(0), bits_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+FrozenIntMap<Key, Value>::iterator::iterator(const FrozenIntMap<Key, Value>* map, size_t index, uint64_t bits) :
+    map_(map), index_(index), bits_(bits)
+{
+
+}
+
+template<typename Key, typename Value>
+std::pair<const Key,Value> FrozenIntMap<Key, Value>::iterator::operator*() const
+{
+    return std::pair<const Key,Value>(key(), value());
+}
+
+template<typename Key, typename Value>
+Key FrozenIntMap<Key, Value>::iterator::key() const
+{
+    return FrozenIntMap<Key, Value>::fromBits(bits_);
+}
+
+template<typename Key, typename Value>
+const Value& FrozenIntMap<Key, Value>::iterator::value() const
+{
+    return map_->values_[index_];
+}
+
+template<typename Key, typename Value>
+bool FrozenIntMap<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return index_ == rhs.index_;
+}
+
+template<typename Key, typename Value>
+bool FrozenIntMap<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Key, typename Value>
+typename FrozenIntMap<Key, Value>::iterator&
+FrozenIntMap<Key, Value>::iterator::operator++()
+{
+    if (++index_ < map_->values_.size())
+    {
+        bits_ = map_->nextBits(index_, bits_);
+    }
+    return *this;
+}
+
+/*
+  ---------------------------------------------------------
+  End implementations for the FrozenIntMap::iterator class.
+  ---------------------------------------------------------
+*/
+
+/*
+  -------------------------------------------------
+  Begin implementations for the FrozenIntMap class.
+  -------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+FrozenIntMap<Key, Value>::FrozenIntMap() :
+    words_(1, 0)
+{
+
+}
+
+/**
+* Builds the map in one pass over items, whose keys must be strictly
+* increasing (throws std::invalid_argument otherwise).
+*/
+template<typename Key, typename Value>
+template<typename Container>
+FrozenIntMap<Key, Value>::FrozenIntMap(const Container& items)
+{
+    size_t n = items.size();
+    size_t blocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    firstKeys_.reserve(blocks);
+    blocks_.reserve(blocks);
+    values_.reserve(n);
+
+    uint64_t keys[BLOCK_SIZE];
+    size_t count = 0;
+    uint64_t bitPos = 0;
+    for (auto it = items.begin(); it != items.end(); ++it)
+    {
+        uint64_t bits = toBits(it->first);
+        if (count && keys[count - 1] >= bits)
+        {
+            throw std::invalid_argument("FrozenIntMap: keys are not strictly increasing");
+        }
+        if (count == BLOCK_SIZE)
+        {
+            packBlock(keys, count, bitPos);
+            count = 0;
+        }
+        keys[count++] = bits;
+        values_.push_back(it->second);
+    }
+    if (count)
+    {
+        packBlock(keys, count, bitPos);
+    }
+    words_.resize(bitPos / 64 + 2, 0);
+    words_.shrink_to_fit();
+}
+
+template<typename Key, typename Value>
+typename FrozenIntMap<Key, Value>::iterator
+FrozenIntMap<Key, Value>::begin() const
+{
+    return iterator(this, 0, firstKeys_.empty() ? 0 : firstKeys_[0]);
+}
+
+template<typename Key, typename Value>
+typename FrozenIntMap<Key, Value>::iterator
+FrozenIntMap<Key, Value>::end() const
+{
+    return iterator(this, values_.size(), 0);
+}
+
+template<typename Key, typename Value>
+typename FrozenIntMap<Key, Value>::iterator
+FrozenIntMap<Key, Value>::find(const Key& key) const
+{
+    iterator it = lower_bound(key);
+    if (it.index_ == values_.size() || it.bits_ != toBits(key))
+    {
+        return end();
+    }
+    return it;
+}
+
+/**
+* The first item whose key is not less than key: binary search the block
+* directory, then decode the block's gaps until reaching key.
+*/
+template<typename Key, typename Value>
+typename FrozenIntMap<Key, Value>::iterator
+FrozenIntMap<Key, Value>::lower_bound(const Key& key) const
+{
+    uint64_t target = toBits(key);
+    size_t block = std::upper_bound(firstKeys_.begin(), firstKeys_.end(), target) - firstKeys_.begin();
+    if (block == 0)
+    {
+        return begin();
+    }
+    --block;
+    size_t index = block * BLOCK_SIZE;
+    size_t last = std::min(values_.size(), index + BLOCK_SIZE) - 1;
+    uint64_t bits = firstKeys_[block];
+    while (bits < target && index < last)
+    {
+        bits = nextBits(++index, bits);
+    }
+    if (bits >= target)
+    {
+        return iterator(this, index, bits);
+    }
+    if (block + 1 < firstKeys_.size())
+    {
+        return iterator(this, index + 1, firstKeys_[block + 1]);
+    }
+    return end();
+}
+
+template<typename Key, typename Value>
+bool FrozenIntMap<Key, Value>::empty() const
+{
+    return values_.empty();
+}
+
+template<typename Key, typename Value>
+size_t FrozenIntMap<Key, Value>::size() const
+{
+    return values_.size();
+}
+
+/**
+* nodeBytes covers the values and the packed keys; treeBytes the object
+* and the block directory.
+*/
+template<typename Key, typename Value>
+MemoryUsage FrozenIntMap<Key, Value>::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.nodes = values_.size();
+    usage.nodeBytes = values_.capacity() * sizeof(Value) + words_.capacity() * sizeof(uint64_t);
+    usage.treeBytes = sizeof(*this) + firstKeys_.capacity() * sizeof(uint64_t) +
+                      blocks_.capacity() * sizeof(Block);
+    if (HeapUsage<Value>::dynamic)
+    {
+        for (size_t i = 0; i < values_.size(); ++i)
+        {
+            usage.keyValueHeapBytes += HeapUsage<Value>::bytes(values_[i]);
+        }
+    }
+    return usage;
+}
+
+/**
+* Maps keys to unsigned integers of the same order: signed keys get their
+* sign bit flipped.
+*/
+template<typename Key, typename Value>
+uint64_t FrozenIntMap<Key, Value>::toBits(const Key& key)
+{
+    if (std::is_signed<Key>::value)
+    {
+        return (uint64_t)(int64_t)key ^ (1ULL << 63);
+    }
+    return (uint64_t)key;
+}
+
+template<typename Key, typename Value>
+Key FrozenIntMap<Key, Value>::fromBits(uint64_t bits)
+{
+    if (std::is_signed<Key>::value)
+    {
+        return (Key)(int64_t)(bits ^ (1ULL << 63));
+    }
+    return (Key)bits;
+}
+
+template<typename Key, typename Value>
+unsigned FrozenIntMap<Key, Value>::bitWidth(uint64_t value)
+{
+    unsigned width = 0;
+    while (width < 64 && (value >> width))
+    {
+        ++width;
+    }
+    return width;
+}
+
+/**
+* The width-bit field at bitPos. Fields may straddle two words; the
+* padding word at the end of words_ makes reading the second one safe.
+*/
+template<typename Key, typename Value>
+uint64_t FrozenIntMap<Key, Value>::readBits(uint64_t bitPos, unsigned width) const
+{
+    const uint64_t* word = &words_[bitPos / 64];
+    unsigned shift = bitPos % 64;
+    uint64_t field = (word[0] >> shift) | ((word[1] << 1) << (63 - shift));
+    return width == 64 ? field : field & ((1ULL << width) - 1);
+}
+
+template<typename Key, typename Value>
+void FrozenIntMap<Key, Value>::appendBits(uint64_t value, unsigned width, uint64_t& bitPos)
+{
+    if (width == 0)
+    {
+        return;
+    }
+    words_.resize((bitPos + width) / 64 + 2, 0);
+    unsigned shift = bitPos % 64;
+    words_[bitPos / 64] |= value << shift;
+    if (shift + width > 64)
+    {
+        words_[bitPos / 64 + 1] |= value >> (64 - shift);
+    }
+    bitPos += width;
+}
+
+/**
+* Appends a block: its first key to the directory, then the remaining
+* gaps minus the smallest one, at the width of the largest remainder.
+*/
+template<typename Key, typename Value>
+void FrozenIntMap<Key, Value>::packBlock(const uint64_t* keys, size_t count, uint64_t& bitPos)
+{
+    uint64_t minGap = ~0ULL;
+    uint64_t maxGap = 0;
+    for (size_t i = 1; i < count; ++i)
+    {
+        uint64_t gap = keys[i] - keys[i - 1];
+        minGap = std::min(minGap, gap);
+        maxGap = std::max(maxGap, gap);
+    }
+    if (count == 1)
+    {
+        minGap = 0;
+    }
+    Block block;
+    block.minGap = minGap;
+    block.bitOffset = bitPos;
+    block.width = (uint8_t)bitWidth(maxGap - minGap);
+    firstKeys_.push_back(keys[0]);
+    blocks_.push_back(block);
+    for (size_t i = 1; i < count; ++i)
+    {
+        appendBits(keys[i] - keys[i - 1] - minGap, block.width, bitPos);
+    }
+}
+
+/**
+* The key of item index given the key of item index - 1: the first key
+* of a new block, or the previous key plus the decoded gap.
+*/
+template<typename Key, typename Value>
+uint64_t FrozenIntMap<Key, Value>::nextBits(size_t index, uint64_t bits) const
+{
+    size_t slot = index % BLOCK_SIZE;
+    size_t blockIndex = index / BLOCK_SIZE;
+    if (slot == 0)
+    {
+        return firstKeys_[blockIndex];
+    }
+    const Block& block = blocks_[blockIndex];
+    return bits + block.minGap + readBits(block.bitOffset + (uint64_t)(slot - 1) * block.width, block.width);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the FrozenIntMap class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef INDEXED_AVLBST_H
+#define INDEXED_AVLBST_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include "avlbst.h"
+
+/**
+* An open-addressing hash table from key to the node holding it. It stores
+* the full hash next to each node pointer, so a probe only looks at a key
+* when the hashes match. Collisions are resolved by linear probing and
+* erase shifts the following entries back, so there are no tombstones and
+* probe sequences stay short. The table doubles once it is 3/4 full.
+*
+* Nodes never change keys (nodeSwap relinks nodes, it does not move items),
+* so an entry stays valid until its node is destroyed.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+class NodeHashIndex
+{
+public:
+    NodeHashIndex(const Compare& compare, const Hash& hash);
+    ~NodeHashIndex();
+
+    Node<Key, Value>* find(const Key& key) const;
+    void insert(Node<Key, Value>* node);  // the key must not be indexed yet
+    void erase(Node<Key, Value>* node);
+    void reserve(size_t count);
+    size_t size() const;
+    size_t bytes() const;
+
+private:
+    struct Slot
+    {
+        size_t hash;
+        Node<Key, Value>* node;  // NULL for an empty slot
+    };
+
+    NodeHashIndex(const NodeHashIndex&) = delete;
+    NodeHashIndex& operator=(const NodeHashIndex&) = delete;
+
+    size_t home(size_t hash) const;
+    void place(size_t hash, Node<Key, Value>* node);
+    void grow();
+
+    Slot* slots_;
+    size_t capacity_;  // 0 or a power of two
+    size_t size_;
+    int shift_;        // 64 - log2(capacity_)
+    Compare compare_;
+    Hash hash_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the NodeHashIndex class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Hash>
+NodeHashIndex<Key, Value, Compare, Hash>::NodeHashIndex(const Compare& compare, const Hash& hash) :
+    slots_(NULL), capacity_(0), size_(0), shift_(64), compare_(compare), hash_(hash)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Hash>
+NodeHashIndex<Key, Value, Compare, Hash>::~NodeHashIndex()
+{
+    std::free(slots_);
+}
+
+/**
+* The first slot to probe for a hash. The hash is multiplied by 2^64/phi
+* and the top bits taken, so identity hashes of clustered integers still
+* spread over the table.
+*/
+template<class Key, class Value, class Compare, class Hash>
+size_t NodeHashIndex<Key, Value, Compare, Hash>::home(size_t hash) const
+{
+    return (size_t)(((uint64_t)hash * 0x9E3779B97F4A7C15ULL) >> shift_);
+}
+
+template<class Key, class Value, class Compare, class Hash>
+Node<Key, Value>* NodeHashIndex<Key, Value, Compare, Hash>::find(const Key& key) const
+{
+    if (!size_)
+    {
+        return NULL;
+    }
+    size_t hash = hash_(key);
+    size_t mask = capacity_ - 1;
+    for (size_t i = home(hash); slots_[i].node; i = (i + 1) & mask)
+    {
+        if (slots_[i].hash == hash &&
+            KeyComparator<Compare>::compare(compare_, key, slots_[i].node->getKey()) == 0)
+        {
+            return slots_[i].node;
+        }
+    }
+    return NULL;
+}
+
+template<class Key, class Value, class Compare, class Hash>
+void NodeHashIndex<Key, Value, Compare, Hash>::insert(Node<Key, Value>* node)
+{
+    reserve(size_ + 1);
+    place(hash_(node->getKey()), node);
+    ++size_;
+}
+
+/**
+* Grows the table until count entries fit under the 3/4 load factor, so
+* that the next inserts cannot fail for lack of room.
+*/
+template<class Key, class Value, class Compare, class Hash>
+void NodeHashIndex<Key, Value, Compare, Hash>::reserve(size_t count)
+{
+    while (count * 4 > capacity_ * 3)
+    {
+        grow();
+    }
+}
+
+template<class Key, class Value, class Compare, class Hash>
+void NodeHashIndex<Key, Value, Compare, Hash>::place(size_t hash, Node<Key, Value>* node)
+{
+    size_t mask = capacity_ - 1;
+    size_t i = home(hash);
+    while (slots_[i].node)
+    {
+        i = (i + 1) & mask;
+    }
+    slots_[i].hash = hash;
+    slots_[i].node = node;
+}
+
+/**
+* Removes the entry for node, then moves every following entry of the
+* probe run that may sit in the hole back into it (backward shift).
+*/
+template<class Key, class Value, class Compare, class Hash>
+void NodeHashIndex<Key, Value, Compare, Hash>::erase(Node<Key, Value>* node)
+{
+    if (!size_)
+    {
+        return;
+    }
+    size_t mask = capacity_ - 1;
+    size_t hole = home(hash_(node->getKey()));
+    while (slots_[hole].node != node)
+    {
+        if (!slots_[hole].node)
+        {
+            return;
+        }
+        hole = (hole + 1) & mask;
+    }
+
+    for (size_t j = (hole + 1) & mask; slots_[j].node; j = (j + 1) & mask)
+    {
+        // the entry at j can fill the hole unless its home lies cyclically
+        // in (hole, j]
+        size_t k = home(slots_[j].hash);
+        bool homeBetween = (hole <= j) ? (hole < k && k <= j) : (hole < k || k <= j);
+        if (!homeBetween)
+        {
+            slots_[hole] = slots_[j];
+            hole = j;
+        }
+    }
+    slots_[hole].node = NULL;
+    --size_;
+}
+
+template<class Key, class Value, class Compare, class Hash>
+void NodeHashIndex<Key, Value, Compare, Hash>::grow()
+{
+    size_t capacity = capacity_ ? capacity_ * 2 : 16;
+    Slot* slots = static_cast<Slot*>(std::calloc(capacity, sizeof(Slot)));
+    if (!slots)
+    {
+        // the old table is still intact
+        throw std::bad_alloc();
+    }
+    Slot* old = slots_;
+    size_t oldCapacity = capacity_;
+    slots_ = slots;
+    capacity_ = capacity;
+    shift_ = 64 - __builtin_ctzll(capacity_);
+    for (size_t i = 0; i < oldCapacity; ++i)
+    {
+        if (old[i].node)
+        {
+            place(old[i].hash, old[i].node);
+        }
+    }
+    std::free(old);
+}
+
+template<class Key, class Value, class Compare, class Hash>
+size_t NodeHashIndex<Key, Value, Compare, Hash>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, class Compare, class Hash>
+size_t NodeHashIndex<Key, Value, Compare, Hash>::bytes() const
+{
+    return capacity_ * sizeof(Slot);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the NodeHashIndex class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVLTree with a hash index over its nodes. find, operator[], remove's
+* lookup and updates of existing keys go through the index in O(1)
+* expected time; new keys, removal, rotations, iteration and partitioning
+* work on the tree as usual. The index is kept up to date in createNode,
+* adoptNode and releaseNode, so every path that allocates, frees or moves
+* a node (insert, remove, clear, compact, extract, merge) maintains it.
+* Costs one 16-byte slot per node at a load factor between 3/8 and 3/4.
+*
+* Hash must be consistent with Compare: keys that compare equivalent must
+* hash equally.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Hash = std::hash<Key> >
+class IndexedAVLTree : public AVLTree<Key, Value, Compare>
+{
+public:
+    explicit IndexedAVLTree(const Compare& compare = Compare(), const Hash& hash = Hash());
+    using AVLTree<Key, Value, Compare>::insert;
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+
+protected:
+    virtual Node<Key, Value>* internalFind(const Key& key) const;
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual void adoptNode(Node<Key, Value>* node);
+    virtual void releaseNode(Node<Key, Value>* node);
+    virtual size_t auxiliaryBytes() const;
+
+    NodeHashIndex<Key, Value, Compare, Hash> index_;
+};
+
+/*
+  --------------------------------------------------
+  Begin implementations for the IndexedAVLTree class.
+  --------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Hash>
+IndexedAVLTree<Key, Value, Compare, Hash>::IndexedAVLTree(const Compare& compare, const Hash& hash) :
+    AVLTree<Key, Value, Compare>(compare), index_(compare, hash)
+{
+
+}
+
+/**
+* Overwrites existing keys (and revives lazily deleted ones) straight
+* through the index; only new keys take the AVL descent.
+*/
+template<class Key, class Value, class Compare, class Hash>
+void IndexedAVLTree<Key, Value, Compare, Hash>::insert(const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* existing = index_.find(new_item.first);
+    if (!existing)
+    {
+        AVLTree<Key, Value, Compare>::insert(new_item);
+        return;
+    }
+    BST_COUNT(inserts, 1);
+    BST_COUNT(nodeVisits, 1);
+    LatencyTimer timer(this->latency_, OP_INSERT);
+    this->overwrite(static_cast<AVLNode<Key, Value>*>(existing), new_item.second);
+}
+
+template<class Key, class Value, class Compare, class Hash>
+Node<Key, Value>* IndexedAVLTree<Key, Value, Compare, Hash>::internalFind(const Key& key) const
+{
+    BST_COUNT(nodeVisits, 1);
+    Node<Key, Value>* node = index_.find(key);
+    if (node && this->tombstones_ && node->isTombstone())
+    {
+        return nullptr;
+    }
+    return node;
+}
+
+template<class Key, class Value, class Compare, class Hash>
+Node<Key, Value>* IndexedAVLTree<Key, Value, Compare, Hash>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    // grow the index first: once the node exists, indexing it cannot fail
+    index_.reserve(index_.size() + 1);
+    Node<Key, Value>* node = AVLTree<Key, Value, Compare>::createNode(key, value, parent);
+    index_.insert(node);
+    return node;
+}
+
+template<class Key, class Value, class Compare, class Hash>
+void IndexedAVLTree<Key, Value, Compare, Hash>::adoptNode(Node<Key, Value>* node)
+{
+    index_.reserve(index_.size() + 1);
+    AVLTree<Key, Value, Compare>::adoptNode(node);
+    index_.insert(node);
+}
+
+template<class Key, class Value, class Compare, class Hash>
+void IndexedAVLTree<Key, Value, Compare, Hash>::releaseNode(Node<Key, Value>* node)
+{
+    index_.erase(node);
+    AVLTree<Key, Value, Compare>::releaseNode(node);
+}
+
+template<class Key, class Value, class Compare, class Hash>
+size_t IndexedAVLTree<Key, Value, Compare, Hash>::auxiliaryBytes() const
+{
+    return index_.bytes();
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the IndexedAVLTree class.
+  ------------------------------------------------
+*/
+
+#endif
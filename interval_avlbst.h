@@ -0,0 +1,302 @@
+#ifndef INTERVAL_AVLBST_H
+#define INTERVAL_AVLBST_H
+
+#include <iostream>
+#include <limits>
+#include <utility>
+#include "augmented_avlbst.h"
+
+/**
+* A closed interval [start, end]. Intervals order by start, then by end,
+* so intervals sharing a start are distinct keys.
+*/
+template <typename T>
+struct Interval
+{
+    T start;
+    T end;
+
+    Interval() :
+        start(), end()
+    {
+
+    }
+
+    Interval(const T& s, const T& e) :
+        start(s), end(e)
+    {
+
+    }
+
+    bool operator<(const Interval<T>& rhs) const
+    {
+        return start < rhs.start || (!(rhs.start < start) && end < rhs.end);
+    }
+
+    bool operator==(const Interval<T>& rhs) const
+    {
+        return !(*this < rhs) && !(rhs < *this);
+    }
+};
+
+template <typename T>
+std::ostream& operator<<(std::ostream& os, const Interval<T>& interval)
+{
+    os << '[' << interval.start << ", " << interval.end << ']';
+    return os;
+}
+
+/**
+* The augmentation of IntervalTree: the largest end in a subtree.
+*/
+template <typename T>
+struct MaxEndMonoid
+{
+    typedef T Summary;
+    static Summary identity() { return std::numeric_limits<T>::lowest(); }
+    template<typename Value>
+    static Summary lift(const Interval<T>& key, const Value&) { return key.end; }
+    static Summary combine(const Summary& a, const Summary& b) { return a < b ? b : a; }
+};
+
+/**
+* An AVL interval tree: items are keyed by Interval<T> (so ordered by
+* start) and every node knows the largest end in its subtree, which
+* AugmentedAVLTree keeps correct through the rotations and updates.
+*
+* overlapping(lo, hi) lists the intervals that intersect [lo, hi], in
+* start order, as a range whose iterator walks the tree with parent
+* pointers and allocates nothing. The walk skips every subtree whose
+* largest end is below lo and stops at the first start beyond hi, so it
+* only visits the matches, their ancestors and the O(log n) nodes along
+* the query's boundaries: O(log n + k) when the matches are clustered and
+* at most O(log n + k log(n / k)) when they are spread out.
+*/
+template <typename T, typename Value>
+class IntervalTree : public AugmentedAVLTree<Interval<T>, Value, MaxEndMonoid<T> >
+{
+public:
+    typedef Interval<T> Key;
+
+    /**
+    * Iterates the intervals that overlap a query, in start order.
+    */
+    class overlap_iterator
+    {
+    public:
+        overlap_iterator();
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const overlap_iterator& rhs) const;
+        bool operator!=(const overlap_iterator& rhs) const;
+
+        overlap_iterator& operator++();
+
+    protected:
+        friend class IntervalTree<T, Value>;
+        overlap_iterator(const IntervalTree<T, Value>* tree, const Node<Key, Value>* node,
+                         const T& lo, const T& hi);
+
+        const IntervalTree<T, Value>* tree_;
+        const Node<Key, Value>* node_;  // NULL at the end
+        T lo_;
+        T hi_;
+    };
+
+    /**
+    * The matches of one query, usable in a range-based for loop.
+    */
+    class overlap_range
+    {
+    public:
+        overlap_range(const overlap_iterator& first, const overlap_iterator& last) :
+            first_(first), last_(last)
+        {
+
+        }
+
+        overlap_iterator begin() const { return first_; }
+        overlap_iterator end() const { return last_; }
+
+    private:
+        overlap_iterator first_;
+        overlap_iterator last_;
+    };
+
+    overlap_range overlapping(const T& lo, const T& hi) const;
+    overlap_range stabbing(const T& point) const;
+
+protected:
+    static const T& maxEnd(const Node<Key, Value>* node);
+    const Node<Key, Value>* firstCandidate(const Node<Key, Value>* node, const T& lo) const;
+    const Node<Key, Value>* afterNode(const Node<Key, Value>* node, const T& lo) const;
+    const Node<Key, Value>* settle(const Node<Key, Value>* node, const T& lo, const T& hi) const;
+};
+
+/*
+  --------------------------------------------------------------
+  Begin implementations for the IntervalTree::overlap_iterator class.
+  --------------------------------------------------------------
+*/
+
+template<typename T, typename Value>
+IntervalTree<T, Value>::overlap_iterator::overlap_iterator() :
+    tree_(NULL), node_(NULL), lo_(), hi_()
+{
+
+}
+
+template<typename T, typename Value>
+IntervalTree<T, Value>::overlap_iterator::overlap_iterator(const IntervalTree<T, Value>* tree,
+                                                           const Node<Key, Value>* node,
+                                                           const T& lo, const T& hi) :
+    tree_(tree), node_(node), lo_(lo), hi_(hi)
+{
+
+}
+
+template<typename T, typename Value>
+const std::pair<const Interval<T>,Value>& IntervalTree<T, Value>::overlap_iterator::operator*() const
+{
+    return node_->getItem();
+}
+
+template<typename T, typename Value>
+const std::pair<const Interval<T>,Value>* IntervalTree<T, Value>::overlap_iterator::operator->() const
+{
+    return &(node_->getItem());
+}
+
+template<typename T, typename Value>
+bool IntervalTree<T, Value>::overlap_iterator::operator==(const overlap_iterator& rhs) const
+{
+    return node_ == rhs.node_;
+}
+
+template<typename T, typename Value>
+bool IntervalTree<T, Value>::overlap_iterator::operator!=(const overlap_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename T, typename Value>
+typename IntervalTree<T, Value>::overlap_iterator&
+IntervalTree<T, Value>::overlap_iterator::operator++()
+{
+    node_ = tree_->settle(tree_->afterNode(node_, lo_), lo_, hi_);
+    return *this;
+}
+
+/*
+  ------------------------------------------------------------
+  End implementations for the IntervalTree::overlap_iterator class.
+  ------------------------------------------------------------
+*/
+
+/*
+  -------------------------------------------------
+  Begin implementations for the IntervalTree class.
+  -------------------------------------------------
+*/
+
+/**
+* The intervals [start, end] with start <= hi and end >= lo.
+*/
+template<typename T, typename Value>
+typename IntervalTree<T, Value>::overlap_range
+IntervalTree<T, Value>::overlapping(const T& lo, const T& hi) const
+{
+    const Node<Key, Value>* first = NULL;
+    if (this->root_ && !(maxEnd(this->root_) < lo))
+    {
+        first = settle(firstCandidate(this->root_, lo), lo, hi);
+    }
+    return overlap_range(overlap_iterator(this, first, lo, hi), overlap_iterator());
+}
+
+/**
+* The intervals containing point.
+*/
+template<typename T, typename Value>
+typename IntervalTree<T, Value>::overlap_range
+IntervalTree<T, Value>::stabbing(const T& point) const
+{
+    return overlapping(point, point);
+}
+
+template<typename T, typename Value>
+const T& IntervalTree<T, Value>::maxEnd(const Node<Key, Value>* node)
+{
+    return static_cast<const typename IntervalTree<T, Value>::AugNode*>(node)->getSummary();
+}
+
+/**
+* The first node of a subtree (whose largest end reaches lo) that can
+* match: go left as long as the left subtree still reaches lo.
+*/
+template<typename T, typename Value>
+const Node<Interval<T>, Value>*
+IntervalTree<T, Value>::firstCandidate(const Node<Key, Value>* node, const T& lo) const
+{
+    while (node->getLeft() && !(maxEnd(node->getLeft()) < lo))
+    {
+        BST_COUNT(nodeVisits, 1);
+        node = node->getLeft();
+    }
+    return node;
+}
+
+/**
+* The next node to consider after node, whose left subtree is done: the
+* first candidate of its right subtree if that reaches lo, otherwise the
+* nearest ancestor reached from its left subtree.
+*/
+template<typename T, typename Value>
+const Node<Interval<T>, Value>*
+IntervalTree<T, Value>::afterNode(const Node<Key, Value>* node, const T& lo) const
+{
+    if (node->getRight() && !(maxEnd(node->getRight()) < lo))
+    {
+        return firstCandidate(node->getRight(), lo);
+    }
+    while (node->getParent() && node == node->getParent()->getRight())
+    {
+        node = node->getParent();
+    }
+    return node->getParent();
+}
+
+/**
+* Walks forward from node to the first match, or returns NULL once a
+* start passes hi, since every later node starts later still.
+*/
+template<typename T, typename Value>
+const Node<Interval<T>, Value>*
+IntervalTree<T, Value>::settle(const Node<Key, Value>* node, const T& lo, const T& hi) const
+{
+    while (node)
+    {
+        BST_COUNT(nodeVisits, 1);
+        const Key& interval = node->getKey();
+        if (hi < interval.start)
+        {
+            return NULL;
+        }
+        if (!(interval.end < lo) && !node->isTombstone())
+        {
+            return node;
+        }
+        node = afterNode(node, lo);
+    }
+    return NULL;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the IntervalTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef LEAF_DEPTH_AVLBST_H
+#define LEAF_DEPTH_AVLBST_H
+
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include "avlbst.h"
+
+/**
+* An AVL node that also knows how far below it its nearest and farthest
+* leaves are (0 for a leaf itself).
+*/
+template <typename Key, typename Value>
+class LeafDepthAVLNode : public AVLNode<Key, Value>
+{
+public:
+    LeafDepthAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+
+    uint8_t getMinLeaf() const;
+    uint8_t getMaxLeaf() const;
+    void setLeafBounds(uint8_t minLeaf, uint8_t maxLeaf);
+
+protected:
+    // an AVL tree's height stays below 1.45 log2(n + 2), well within 8 bits
+    uint8_t minLeaf_;
+    uint8_t maxLeaf_;
+};
+
+/*
+  -----------------------------------------------------
+  Begin implementations for the LeafDepthAVLNode class.
+  -----------------------------------------------------
+*/
+
+template<class Key, class Value>
+LeafDepthAVLNode<Key, Value>::LeafDepthAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), minLeaf_(0), maxLeaf_(0)
+{
+
+}
+
+template<class Key, class Value>
+uint8_t LeafDepthAVLNode<Key, Value>::getMinLeaf() const
+{
+    return minLeaf_;
+}
+
+template<class Key, class Value>
+uint8_t LeafDepthAVLNode<Key, Value>::getMaxLeaf() const
+{
+    return maxLeaf_;
+}
+
+template<class Key, class Value>
+void LeafDepthAVLNode<Key, Value>::setLeafBounds(uint8_t minLeaf, uint8_t maxLeaf)
+{
+    minLeaf_ = minLeaf;
+    maxLeaf_ = maxLeaf;
+}
+
+/*
+  ---------------------------------------------------
+  End implementations for the LeafDepthAVLNode class.
+  ---------------------------------------------------
+*/
+
+/**
+* An AVLTree that keeps, in every node, the depth of the shallowest and
+* the deepest leaf of its subtree, so the root answers equalPaths (do all
+* leaves sit at the same depth?) in O(1) instead of an O(n) walk.
+*
+* The bounds depend on the tree's shape, not on its items, and are kept
+* up to date through AVLTree's refresh hooks: each rotation recomputes
+* the two rotated nodes and each insert and remove the path from the
+* lowest changed node to the root, O(log n) per update. A leaf is a node
+* without children, as in equalPaths; lazily deleted nodes still count,
+* since they are still part of the shape.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class LeafDepthAVLTree : public AVLTree<Key, Value, Compare>
+{
+public:
+    explicit LeafDepthAVLTree(const Compare& compare = Compare());
+
+    bool equalPaths() const;
+    size_t minLeafDepth() const;
+    size_t maxLeafDepth() const;
+    size_t leafDepthSpread() const;
+
+protected:
+    typedef LeafDepthAVLNode<Key, Value> DepthNode;
+
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual size_t nodeSize() const;
+    virtual void refreshNode(AVLNode<Key, Value>* node);
+    virtual void refreshPath(AVLNode<Key, Value>* node);
+
+    const DepthNode* root() const;
+};
+
+/*
+  -----------------------------------------------------
+  Begin implementations for the LeafDepthAVLTree class.
+  -----------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+LeafDepthAVLTree<Key, Value, Compare>::LeafDepthAVLTree(const Compare& compare) :
+    AVLTree<Key, Value, Compare>(compare)
+{
+
+}
+
+/**
+* True if every leaf is at the same depth (and for an empty tree).
+*/
+template<class Key, class Value, class Compare>
+bool LeafDepthAVLTree<Key, Value, Compare>::equalPaths() const
+{
+    return leafDepthSpread() == 0;
+}
+
+/**
+* The depth of the shallowest leaf; 0 for an empty tree.
+*/
+template<class Key, class Value, class Compare>
+size_t LeafDepthAVLTree<Key, Value, Compare>::minLeafDepth() const
+{
+    return root() ? root()->getMinLeaf() : 0;
+}
+
+/**
+* The depth of the deepest leaf, which is the tree's height; 0 for an
+* empty tree.
+*/
+template<class Key, class Value, class Compare>
+size_t LeafDepthAVLTree<Key, Value, Compare>::maxLeafDepth() const
+{
+    return root() ? root()->getMaxLeaf() : 0;
+}
+
+/**
+* How far the tree is from having all leaves at one depth: the deepest
+* leaf's depth minus the shallowest's. 0 exactly when equalPaths() holds.
+*/
+template<class Key, class Value, class Compare>
+size_t LeafDepthAVLTree<Key, Value, Compare>::leafDepthSpread() const
+{
+    return maxLeafDepth() - minLeafDepth();
+}
+
+template<class Key, class Value, class Compare>
+Node<Key, Value>* LeafDepthAVLTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    Node<Key, Value>* node = new DepthNode(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+    ++this->size_;
+    return node;
+}
+
+template<class Key, class Value, class Compare>
+size_t LeafDepthAVLTree<Key, Value, Compare>::nodeSize() const
+{
+    return sizeof(DepthNode);
+}
+
+/**
+* A leaf is 0/0; otherwise one more than the children's bounds, taken
+* over the children that exist.
+*/
+template<class Key, class Value, class Compare>
+void LeafDepthAVLTree<Key, Value, Compare>::refreshNode(AVLNode<Key, Value>* node)
+{
+    const DepthNode* left = static_cast<const DepthNode*>(node->getLeft());
+    const DepthNode* right = static_cast<const DepthNode*>(node->getRight());
+    uint8_t minLeaf = 0;
+    uint8_t maxLeaf = 0;
+    if (left && right)
+    {
+        minLeaf = 1 + std::min(left->getMinLeaf(), right->getMinLeaf());
+        maxLeaf = 1 + std::max(left->getMaxLeaf(), right->getMaxLeaf());
+    }
+    else if (left || right)
+    {
+        const DepthNode* child = left ? left : right;
+        minLeaf = 1 + child->getMinLeaf();
+        maxLeaf = 1 + child->getMaxLeaf();
+    }
+    static_cast<DepthNode*>(node)->setLeafBounds(minLeaf, maxLeaf);
+}
+
+template<class Key, class Value, class Compare>
+void LeafDepthAVLTree<Key, Value, Compare>::refreshPath(AVLNode<Key, Value>* node)
+{
+    for (; node; node = node->getParent())
+    {
+        refreshNode(node);
+    }
+}
+
+template<class Key, class Value, class Compare>
+const typename LeafDepthAVLTree<Key, Value, Compare>::DepthNode*
+LeafDepthAVLTree<Key, Value, Compare>::root() const
+{
+    return static_cast<const DepthNode*>(this->root_);
+}
+
+/*
+  ---------------------------------------------------
+  End implementations for the LeafDepthAVLTree class.
+  ---------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef MULTIMAP_AVLBST_H
+#define MULTIMAP_AVLBST_H
+
+#include <vector>
+#include <utility>
+#include <functional>
+#include "avlbst.h"
+
+/**
+* An ordered multimap: one AVLTree node per distinct key, holding all of
+* that key's values in a contiguous bucket in insertion order. Duplicates
+* add no nodes, so the tree's depth depends only on the number of distinct
+* keys, and insert appends to the bucket in amortized O(1) once the key is
+* found.
+*
+* Iteration visits a key's values in insertion order before moving on to
+* the key's successor. An iterator is a node plus an index into its
+* bucket; inserting or erasing values of a key invalidates iterators into
+* that key's bucket, and erasing a key's last value removes its node.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class AVLMultiMap
+{
+public:
+    typedef std::vector<Value> Bucket;
+    typedef AVLTree<Key, Bucket, Compare> Tree;
+    typedef std::pair<const Key&, Value&> reference;
+
+    explicit AVLMultiMap(const Compare& compare = Compare());
+
+    /**
+    * An in-order iterator over every value: a key's bucket, then the next
+    * key's. Dereferences to a (key, value) pair of references.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        reference operator*() const;
+        const Key& key() const;
+        Value& value() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class AVLMultiMap<Key, Value, Compare>;
+        iterator(const typename Tree::iterator& node, size_t index);
+
+        typename Tree::iterator node_;
+        size_t index_;  // position in node_'s bucket
+    };
+
+    typedef std::pair<iterator, iterator> range;
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    bool erase_one(const Key& key);
+    size_t erase(const Key& key);
+    void clear();
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    range equal_range(const Key& key) const;
+    size_t count(const Key& key) const;
+
+    bool empty() const;
+    size_t size() const;
+    size_t keys() const;
+
+private:
+    Tree tree_;
+    size_t size_;  // values, over all buckets
+};
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the AVLMultiMap::iterator class.
+  ----------------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+AVLMultiMap<Key, Value, Compare>::iterator::iterator() :
+    node_(), index_(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+AVLMultiMap<Key, Value, Compare>::iterator::iterator(const typename Tree::iterator& node, size_t index) :
+    node_(node), index_(index)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+typename AVLMultiMap<Key, Value, Compare>::reference
+AVLMultiMap<Key, Value, Compare>::iterator::operator*() const
+{
+    return reference(node_->first, node_->second[index_]);
+}
+
+template<typename Key, typename Value, typename Compare>
+const Key& AVLMultiMap<Key, Value, Compare>::iterator::key() const
+{
+    return node_->first;
+}
+
+template<typename Key, typename Value, typename Compare>
+Value& AVLMultiMap<Key, Value, Compare>::iterator::value() const
+{
+    return node_->second[index_];
+}
+
+template<typename Key, typename Value, typename Compare>
+bool AVLMultiMap<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return node_ == rhs.node_ && index_ == rhs.index_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool AVLMultiMap<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* The next value in the bucket, or the first value of the successor key.
+*/
+template<typename Key, typename Value, typename Compare>
+typename AVLMultiMap<Key, Value, Compare>::iterator&
+AVLMultiMap<Key, Value, Compare>::iterator::operator++()
+{
+    if (++index_ == node_->second.size())
+    {
+        ++node_;
+        index_ = 0;
+    }
+    return *this;
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the AVLMultiMap::iterator class.
+  --------------------------------------------------------
+*/
+
+/*
+  ------------------------------------------------
+  Begin implementations for the AVLMultiMap class.
+  ------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+AVLMultiMap<Key, Value, Compare>::AVLMultiMap(const Compare& compare) :
+    tree_(compare), size_(0)
+{
+
+}
+
+/**
+* Appends the value to its key's bucket, adding the key with an empty
+* bucket first if it is new; one descent either way.
+*/
+template<typename Key, typename Value, typename Compare>
+void AVLMultiMap<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::pair<typename Tree::iterator, bool> result =
+        tree_.tryInsert(std::pair<const Key, Bucket>(keyValuePair.first, Bucket()));
+    try
+    {
+        result.first->second.push_back(keyValuePair.second);
+    }
+    catch (...)
+    {
+        // never leave a key without values behind
+        if (result.second)
+        {
+            tree_.remove(keyValuePair.first);
+        }
+        throw;
+    }
+    ++size_;
+}
+
+/**
+* Removes the most recently inserted value of key, and the key itself if
+* that was its last value. Returns false if key is absent.
+*/
+template<typename Key, typename Value, typename Compare>
+bool AVLMultiMap<Key, Value, Compare>::erase_one(const Key& key)
+{
+    typename Tree::iterator it = tree_.find(key);
+    if (it == tree_.end())
+    {
+        return false;
+    }
+    if (it->second.size() == 1)
+    {
+        tree_.remove(key);
+    }
+    else
+    {
+        it->second.pop_back();
+    }
+    --size_;
+    return true;
+}
+
+/**
+* Removes key with all of its values; returns how many values it had.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t AVLMultiMap<Key, Value, Compare>::erase(const Key& key)
+{
+    typename Tree::iterator it = tree_.find(key);
+    if (it == tree_.end())
+    {
+        return 0;
+    }
+    size_t removed = it->second.size();
+    tree_.remove(key);
+    size_ -= removed;
+    return removed;
+}
+
+template<typename Key, typename Value, typename Compare>
+void AVLMultiMap<Key, Value, Compare>::clear()
+{
+    tree_.clear();
+    size_ = 0;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename AVLMultiMap<Key, Value, Compare>::iterator
+AVLMultiMap<Key, Value, Compare>::begin() const
+{
+    return iterator(tree_.begin(), 0);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename AVLMultiMap<Key, Value, Compare>::iterator
+AVLMultiMap<Key, Value, Compare>::end() const
+{
+    return iterator(tree_.end(), 0);
+}
+
+/**
+* The first value of key, or end().
+*/
+template<typename Key, typename Value, typename Compare>
+typename AVLMultiMap<Key, Value, Compare>::iterator
+AVLMultiMap<Key, Value, Compare>::find(const Key& key) const
+{
+    return iterator(tree_.find(key), 0);
+}
+
+/**
+* All values of key, in insertion order; an empty range if key is absent.
+*/
+template<typename Key, typename Value, typename Compare>
+typename AVLMultiMap<Key, Value, Compare>::range
+AVLMultiMap<Key, Value, Compare>::equal_range(const Key& key) const
+{
+    typename Tree::iterator first = tree_.find(key);
+    typename Tree::iterator last = first;
+    if (last != tree_.end())
+    {
+        ++last;
+    }
+    return range(iterator(first, 0), iterator(last, 0));
+}
+
+template<typename Key, typename Value, typename Compare>
+size_t AVLMultiMap<Key, Value, Compare>::count(const Key& key) const
+{
+    typename Tree::iterator it = tree_.find(key);
+    return it == tree_.end() ? 0 : it->second.size();
+}
+
+template<typename Key, typename Value, typename Compare>
+bool AVLMultiMap<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* The number of values, counting duplicates.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t AVLMultiMap<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* The number of distinct keys, which is the number of tree nodes.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t AVLMultiMap<Key, Value, Compare>::keys() const
+{
+    return tree_.size();
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the AVLMultiMap class.
+  ----------------------------------------------
+*/
+
+#endif
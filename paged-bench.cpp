@@ -0,0 +1,202 @@
+// Benchmark for the disk-resident PagedBTree (paged_bst.h).
+//
+// Builds a map holding --data-mb megabytes of 16-byte items (64-bit key
+// and value) in --file, inserting in random key order through a buffer
+// pool of --pool-mb, then times random finds and a full in-order scan.
+// Each op prints one CSV line with the page reads and writes it caused,
+// so the bounded-reads-per-lookup claim can be checked from the output:
+//
+//   ./paged-bench --data-mb 1024 --pool-mb 64 --finds 200000
+//
+// The buffer pool only bounds the tree's own memory; the OS page cache
+// still keeps recently read pages around. bench-paged.sh runs this
+// program inside a cgroup whose memory limit also covers the page cache,
+// with the data set four times the limit, which is the out-of-core case.
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include <sys/resource.h>
+#include "paged_bst.h"
+
+using namespace std;
+
+typedef uint64_t BenchKey;
+typedef uint64_t BenchValue;
+
+struct PagedBenchConfig
+{
+    string file;
+    size_t dataMb;
+    size_t poolMb;
+    size_t finds;
+    uint64_t seed;
+    bool keep;
+};
+
+// Spreads 0..n-1 over the 64-bit key space without collisions, so item i
+// can be looked up again without remembering the keys.
+static BenchKey scramble(uint64_t rank)
+{
+    return rank * 0x9E3779B97F4A7C15ULL;
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while (b)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static long peakRssKb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void printHeader()
+{
+    cout << "op,items,pool_pages,height,file_pages,ops,ns_per_op,page_reads_per_op,"
+         << "page_writes_per_op,pool_hit_rate,peak_rss_kb,checksum" << endl;
+}
+
+static void printResult(const string& op, const PagedBTree<BenchKey, BenchValue>& tree, size_t poolPages,
+                        size_t ops, double seconds, const PagerStats& before, uint64_t checksum)
+{
+    PagerStats after = tree.pagerStats();
+    uint64_t fetches = (after.hits - before.hits) + (after.misses - before.misses);
+    double perOp = ops ? 1.0 / ops : 0.0;
+    cout << op << "," << tree.size() << "," << poolPages << "," << tree.height() << ","
+         << tree.pages() << "," << ops << "," << seconds * 1e9 * perOp << ","
+         << (after.reads - before.reads) * perOp << "," << (after.writes - before.writes) * perOp << ","
+         << (fetches ? (double)(after.hits - before.hits) / fetches : 0.0) << ","
+         << peakRssKb() << "," << checksum << endl;
+}
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void run(const PagedBenchConfig& cfg)
+{
+    size_t items = cfg.dataMb * 1024 * 1024 / (sizeof(BenchKey) + sizeof(BenchValue));
+    size_t poolPages = cfg.poolMb * 1024 * 1024 / PAGE_SIZE;
+    std::remove(cfg.file.c_str());
+    PagedBTree<BenchKey, BenchValue> tree(cfg.file, poolPages);
+
+    // insert ranks 0..items-1 in a random order: a random permutation
+    // would not fit in memory, so walk the ranks with a stride coprime to
+    // items, which scramble() then spreads over the key space
+    mt19937_64 rng(cfg.seed);
+    uint64_t stride = (rng() % items) | 1;
+    while (gcd(stride, items) != 1)
+    {
+        stride += 2;
+    }
+    PagerStats before = tree.pagerStats();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint64_t rank = 0;
+    for (size_t i = 0; i < items; ++i)
+    {
+        rank = (rank + stride) % items;
+        tree.insert(make_pair(scramble(rank), (BenchValue)rank));
+    }
+    tree.flush();
+    printResult("insert", tree, poolPages, items, secondsSince(start), before, 0);
+
+    before = tree.pagerStats();
+    start = chrono::steady_clock::now();
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < cfg.finds; ++i)
+    {
+        BenchValue value = 0;
+        tree.find(scramble(rng() % items), value);
+        checksum += value;
+    }
+    printResult("find", tree, poolPages, cfg.finds, secondsSince(start), before, checksum);
+
+    before = tree.pagerStats();
+    start = chrono::steady_clock::now();
+    checksum = 0;
+    size_t scanned = 0;
+    for (PagedBTree<BenchKey, BenchValue>::iterator it = tree.begin(); it != tree.end(); ++it)
+    {
+        checksum += it.value();
+        ++scanned;
+    }
+    printResult("scan", tree, poolPages, scanned, secondsSince(start), before, checksum);
+}
+
+static void usage(const char* prog)
+{
+    cerr << "usage: " << prog << " [--file PATH] [--data-mb N] [--pool-mb N] [--finds N]\n"
+         << "       [--seed N] [--keep]" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    PagedBenchConfig cfg;
+    cfg.file = "paged-bench.db";
+    cfg.dataMb = 64;
+    cfg.poolMb = 16;
+    cfg.finds = 100000;
+    cfg.seed = 42;
+    cfg.keep = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--keep")
+        {
+            cfg.keep = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        string val = argv[++i];
+        if (arg == "--file") cfg.file = val;
+        else if (arg == "--data-mb") cfg.dataMb = strtoull(val.c_str(), NULL, 10);
+        else if (arg == "--pool-mb") cfg.poolMb = strtoull(val.c_str(), NULL, 10);
+        else if (arg == "--finds") cfg.finds = strtoull(val.c_str(), NULL, 10);
+        else if (arg == "--seed") cfg.seed = strtoull(val.c_str(), NULL, 10);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (cfg.dataMb == 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printHeader();
+    try
+    {
+        run(cfg);
+    }
+    catch (const exception& e)
+    {
+        cerr << "paged-bench: " << e.what() << endl;
+        return 1;
+    }
+    if (!cfg.keep)
+    {
+        std::remove(cfg.file.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,635 @@
+#ifndef PAGED_BST_H
+#define PAGED_BST_H
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include "bst_pager.h"
+
+/**
+* An ordered map that lives in a local file, for indexes larger than RAM.
+* Items are packed into PAGE_SIZE pages forming a B+tree: inner pages
+* hold separator keys and child page numbers, leaf pages hold the items
+* in key order and link to the next leaf. Only the pages in the
+* BufferPool (poolPages of them, CLOCK eviction) are in memory.
+*
+* With a fanout in the hundreds the tree stays a few pages deep, and find
+* reads at most height() pages, usually only the leaf once the pool holds
+* the inner levels. insert splits full pages on the way down, so it pins
+* at most three pages at a time; remove pins one. remove does not merge
+* underfull pages: freed slots are reused by later inserts into the same
+* leaf, empty leaves stay in the chain (iteration skips them) and the
+* file never shrinks except through clear().
+*
+* Key and Value are stored as raw bytes, so they must be trivially
+* copyable. Changes reach the file on flush() and on destruction; there
+* is no log, so a crash before that can leave the file inconsistent.
+* Reopening the file restores the map. Not thread-safe.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class PagedBTree
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "PagedBTree keys are stored as raw bytes");
+    static_assert(std::is_trivially_copyable<Value>::value, "PagedBTree values are stored as raw bytes");
+
+public:
+    static const size_t MIN_POOL_PAGES = 4;
+
+    explicit PagedBTree(const std::string& path, size_t poolPages = 256, const Compare& compare = Compare());
+    ~PagedBTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    void clear();
+    void flush();
+
+    bool empty() const;
+    size_t size() const;
+    size_t height() const;
+    size_t pages() const;
+    PagerStats pagerStats() const;
+
+    /**
+    * An in-order iterator along the leaf chain. It pins its current leaf,
+    * so items are returned by value and the map must not be modified
+    * while an iterator is alive.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value> operator*() const;
+        const Key& key() const;
+        const Value& value() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PagedBTree<Key, Value, Compare>;
+        iterator(const PagedBTree<Key, Value, Compare>* tree, const BufferPool::PageRef& leaf);
+        void skipExhaustedLeaves();
+
+        const PagedBTree<Key, Value, Compare>* tree_;
+        BufferPool::PageRef leaf_;  // empty at the end
+        size_t index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+
+private:
+    typedef BufferPool::PageRef PageRef;
+
+    struct PageHeader
+    {
+        uint16_t leaf;
+        uint16_t count;
+        PageId next;  // the next leaf, or 0 (page 0 is the meta page)
+    };
+
+    // conservative: leaves room for padding before each array
+    static const size_t LEAF_CAPACITY =
+        (PAGE_SIZE - sizeof(PageHeader) - alignof(Key) - alignof(Value)) / (sizeof(Key) + sizeof(Value));
+    static const size_t INNER_CAPACITY =
+        (PAGE_SIZE - sizeof(PageHeader) - sizeof(PageId) - alignof(Key) - alignof(PageId)) /
+        (sizeof(Key) + sizeof(PageId));
+
+    struct LeafPage
+    {
+        PageHeader header;
+        Key keys[LEAF_CAPACITY];
+        Value values[LEAF_CAPACITY];
+    };
+
+    struct InnerPage
+    {
+        PageHeader header;
+        Key keys[INNER_CAPACITY];
+        PageId children[INNER_CAPACITY + 1];  // children[i] holds the keys below keys[i]
+    };
+
+    struct MetaPage
+    {
+        uint64_t magic;
+        uint32_t pageSize;
+        uint32_t keySize;
+        uint32_t valueSize;
+        uint32_t height;
+        PageId root;
+        uint64_t size;
+    };
+
+    static_assert(LEAF_CAPACITY >= 2 && sizeof(LeafPage) <= PAGE_SIZE, "Key and Value too large for a page");
+    static_assert(INNER_CAPACITY >= 3 && sizeof(InnerPage) <= PAGE_SIZE, "Key too large for a page");
+
+    static const uint64_t MAGIC = 0x3154424547415050ULL;  // "PPAGEBT1"
+
+    PagedBTree(const PagedBTree&) = delete;
+    PagedBTree& operator=(const PagedBTree&) = delete;
+
+    static PageHeader* header(const PageRef& page);
+    static LeafPage* leaf(const PageRef& page);
+    static InnerPage* inner(const PageRef& page);
+    static bool full(const PageRef& page);
+
+    void initialize();
+    void load();
+    void writeMeta();
+    size_t lowerBound(const Key* keys, size_t count, const Key& key) const;
+    size_t upperBound(const Key* keys, size_t count, const Key& key) const;
+    PageRef findLeaf(const Key& key) const;
+    void splitChild(const PageRef& parent, size_t i, const PageRef& child);
+
+    PageFile file_;
+    mutable BufferPool pool_;
+    Compare compare_;
+    PageId root_;
+    size_t height_;  // 1 when the root is a leaf
+    size_t size_;
+};
+
+/*
+  ---------------------------------------------------------
+  Begin implementations for the PagedBTree::iterator class.
+  ---------------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+PagedBTree<Key, Value, Compare>::iterator::iterator() :
+    tree_(NULL), leaf_(), index_(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+PagedBTree<Key, Value, Compare>::iterator::iterator(const PagedBTree<Key, Value, Compare>* tree,
+                                                    const BufferPool::PageRef& leaf) :
+    tree_(tree), leaf_(leaf), index_(0)
+{
+    skipExhaustedLeaves();
+}
+
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key,Value> PagedBTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return std::pair<const Key,Value>(key(), value());
+}
+
+template<typename Key, typename Value, typename Compare>
+const Key& PagedBTree<Key, Value, Compare>::iterator::key() const
+{
+    return PagedBTree::leaf(leaf_)->keys[index_];
+}
+
+template<typename Key, typename Value, typename Compare>
+const Value& PagedBTree<Key, Value, Compare>::iterator::value() const
+{
+    return PagedBTree::leaf(leaf_)->values[index_];
+}
+
+template<typename Key, typename Value, typename Compare>
+bool PagedBTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    if (!leaf_ || !rhs.leaf_)
+    {
+        return !leaf_ && !rhs.leaf_;
+    }
+    return leaf_.id() == rhs.leaf_.id() && index_ == rhs.index_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool PagedBTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename PagedBTree<Key, Value, Compare>::iterator&
+PagedBTree<Key, Value, Compare>::iterator::operator++()
+{
+    ++index_;
+    skipExhaustedLeaves();
+    return *this;
+}
+
+/**
+* Follows the leaf chain past the end of the current leaf, and past any
+* empty leaves that remove left behind.
+*/
+template<typename Key, typename Value, typename Compare>
+void PagedBTree<Key, Value, Compare>::iterator::skipExhaustedLeaves()
+{
+    while (leaf_ && index_ == PagedBTree::header(leaf_)->count)
+    {
+        PageId next = PagedBTree::header(leaf_)->next;
+        leaf_ = next ? tree_->pool_.fetch(next) : BufferPool::PageRef();
+        index_ = 0;
+    }
+}
+
+/*
+  -------------------------------------------------------
+  End implementations for the PagedBTree::iterator class.
+  -------------------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the PagedBTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Opens the map stored in path, or starts an empty one if the file is
+* new or empty. Throws std::runtime_error if the file holds something
+* else, including a map with different key or value sizes.
+*/
+template<typename Key, typename Value, typename Compare>
+PagedBTree<Key, Value, Compare>::PagedBTree(const std::string& path, size_t poolPages, const Compare& compare) :
+    file_(path), pool_(file_, poolPages < MIN_POOL_PAGES ? MIN_POOL_PAGES : poolPages), compare_(compare),
+    root_(0), height_(0), size_(0)
+{
+    if (file_.pages() == 0)
+    {
+        initialize();
+    }
+    else
+    {
+        load();
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+PagedBTree<Key, Value, Compare>::~PagedBTree()
+{
+    try
+    {
+        writeMeta();
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+/**
+* Inserts or overwrites. Full pages met on the way down are split first,
+* so the leaf always has room and no split has to climb back up.
+*/
+template<typename Key, typename Value, typename Compare>
+void PagedBTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    PageRef node = pool_.fetch(root_);
+    if (full(node))
+    {
+        PageRef root = pool_.create();
+        inner(root)->header = PageHeader{0, 0, 0};
+        inner(root)->children[0] = root_;
+        splitChild(root, 0, node);
+        root_ = root.id();
+        ++height_;
+        node = std::move(root);
+    }
+    while (!header(node)->leaf)
+    {
+        InnerPage* page = inner(node);
+        size_t i = upperBound(page->keys, page->header.count, key);
+        PageRef child = pool_.fetch(page->children[i]);
+        if (full(child))
+        {
+            splitChild(node, i, child);
+            if (!compare_(key, page->keys[i]))
+            {
+                child = pool_.fetch(page->children[i + 1]);
+            }
+        }
+        node = std::move(child);
+    }
+
+    LeafPage* page = leaf(node);
+    size_t count = page->header.count;
+    size_t pos = lowerBound(page->keys, count, key);
+    node.markDirty();
+    if (pos < count && !compare_(key, page->keys[pos]))
+    {
+        page->values[pos] = keyValuePair.second;
+        return;
+    }
+    std::memmove(page->keys + pos + 1, page->keys + pos, (count - pos) * sizeof(Key));
+    std::memmove(page->values + pos + 1, page->values + pos, (count - pos) * sizeof(Value));
+    page->keys[pos] = key;
+    page->values[pos] = keyValuePair.second;
+    ++page->header.count;
+    ++size_;
+}
+
+template<typename Key, typename Value, typename Compare>
+void PagedBTree<Key, Value, Compare>::remove(const Key& key)
+{
+    PageRef node = findLeaf(key);
+    LeafPage* page = leaf(node);
+    size_t count = page->header.count;
+    size_t pos = lowerBound(page->keys, count, key);
+    if (pos == count || compare_(key, page->keys[pos]))
+    {
+        return;
+    }
+    std::memmove(page->keys + pos, page->keys + pos + 1, (count - pos - 1) * sizeof(Key));
+    std::memmove(page->values + pos, page->values + pos + 1, (count - pos - 1) * sizeof(Value));
+    --page->header.count;
+    node.markDirty();
+    --size_;
+}
+
+/**
+* Copies the value of key into value and returns true, or returns false
+* if key is absent. Reads at most height() pages.
+*/
+template<typename Key, typename Value, typename Compare>
+bool PagedBTree<Key, Value, Compare>::find(const Key& key, Value& value) const
+{
+    PageRef node = findLeaf(key);
+    const LeafPage* page = leaf(node);
+    size_t pos = lowerBound(page->keys, page->header.count, key);
+    if (pos == page->header.count || compare_(key, page->keys[pos]))
+    {
+        return false;
+    }
+    value = page->values[pos];
+    return true;
+}
+
+/**
+* Removes every item and shrinks the file back to an empty map.
+*/
+template<typename Key, typename Value, typename Compare>
+void PagedBTree<Key, Value, Compare>::clear()
+{
+    pool_.discard();
+    file_.truncate(0);
+    initialize();
+}
+
+/**
+* Writes every change back to the file and syncs it.
+*/
+template<typename Key, typename Value, typename Compare>
+void PagedBTree<Key, Value, Compare>::flush()
+{
+    writeMeta();
+    pool_.flush();
+}
+
+template<typename Key, typename Value, typename Compare>
+bool PagedBTree<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+template<typename Key, typename Value, typename Compare>
+size_t PagedBTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* The number of page levels, which bounds the pages a lookup reads.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t PagedBTree<Key, Value, Compare>::height() const
+{
+    return height_;
+}
+
+/**
+* The number of pages in the file, including the meta page.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t PagedBTree<Key, Value, Compare>::pages() const
+{
+    return file_.pages();
+}
+
+template<typename Key, typename Value, typename Compare>
+PagerStats PagedBTree<Key, Value, Compare>::pagerStats() const
+{
+    return pool_.stats();
+}
+
+template<typename Key, typename Value, typename Compare>
+typename PagedBTree<Key, Value, Compare>::iterator
+PagedBTree<Key, Value, Compare>::begin() const
+{
+    PageRef node = pool_.fetch(root_);
+    while (!header(node)->leaf)
+    {
+        node = pool_.fetch(inner(node)->children[0]);
+    }
+    return iterator(this, node);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename PagedBTree<Key, Value, Compare>::iterator
+PagedBTree<Key, Value, Compare>::end() const
+{
+    return iterator();
+}
+
+template<typename Key, typename Value, typename Compare>
+typename PagedBTree<Key, Value, Compare>::PageHeader*
+PagedBTree<Key, Value, Compare>::header(const PageRef& page)
+{
+    return reinterpret_cast<PageHeader*>(page.data());
+}
+
+template<typename Key, typename Value, typename Compare>
+typename PagedBTree<Key, Value, Compare>::LeafPage*
+PagedBTree<Key, Value, Compare>::leaf(const PageRef& page)
+{
+    return reinterpret_cast<LeafPage*>(page.data());
+}
+
+template<typename Key, typename Value, typename Compare>
+typename PagedBTree<Key, Value, Compare>::InnerPage*
+PagedBTree<Key, Value, Compare>::inner(const PageRef& page)
+{
+    return reinterpret_cast<InnerPage*>(page.data());
+}
+
+template<typename Key, typename Value, typename Compare>
+bool PagedBTree<Key, Value, Compare>::full(const PageRef& page)
+{
+    const PageHeader* h = header(page);
+    return h->count == (h->leaf ? LEAF_CAPACITY : INNER_CAPACITY);
+}
+
+/**
+* Lays out an empty map: the meta page, then an empty root leaf.
+*/
+template<typename Key, typename Value, typename Compare>
+void PagedBTree<Key, Value, Compare>::initialize()
+{
+    PageRef meta = pool_.create();
+    PageRef root = pool_.create();
+    leaf(root)->header = PageHeader{1, 0, 0};
+    root_ = root.id();
+    height_ = 1;
+    size_ = 0;
+    writeMeta();
+}
+
+template<typename Key, typename Value, typename Compare>
+void PagedBTree<Key, Value, Compare>::load()
+{
+    MetaPage meta;
+    std::memcpy(&meta, pool_.fetch(0).data(), sizeof(meta));
+    if (meta.magic != MAGIC || meta.pageSize != PAGE_SIZE ||
+        meta.keySize != sizeof(Key) || meta.valueSize != sizeof(Value))
+    {
+        throw std::runtime_error("PagedBTree: file holds no map of this key and value type");
+    }
+    root_ = meta.root;
+    height_ = meta.height;
+    size_ = meta.size;
+}
+
+template<typename Key, typename Value, typename Compare>
+void PagedBTree<Key, Value, Compare>::writeMeta()
+{
+    MetaPage meta = {MAGIC, (uint32_t)PAGE_SIZE, (uint32_t)sizeof(Key), (uint32_t)sizeof(Value),
+                     (uint32_t)height_, root_, (uint64_t)size_};
+    PageRef page = pool_.fetch(0);
+    std::memcpy(page.data(), &meta, sizeof(meta));
+    page.markDirty();
+}
+
+/**
+* The first position whose key is not less than key.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t PagedBTree<Key, Value, Compare>::lowerBound(const Key* keys, size_t count, const Key& key) const
+{
+    size_t lo = 0;
+    while (count > 0)
+    {
+        size_t half = count / 2;
+        if (compare_(keys[lo + half], key))
+        {
+            lo += half + 1;
+            count -= half + 1;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+    return lo;
+}
+
+/**
+* The first position whose key is greater than key: the child of an
+* inner page to descend into.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t PagedBTree<Key, Value, Compare>::upperBound(const Key* keys, size_t count, const Key& key) const
+{
+    size_t lo = 0;
+    while (count > 0)
+    {
+        size_t half = count / 2;
+        if (!compare_(key, keys[lo + half]))
+        {
+            lo += half + 1;
+            count -= half + 1;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+    return lo;
+}
+
+/**
+* Descends to the leaf that holds or would hold key, pinning one page at
+* a time.
+*/
+template<typename Key, typename Value, typename Compare>
+typename PagedBTree<Key, Value, Compare>::PageRef
+PagedBTree<Key, Value, Compare>::findLeaf(const Key& key) const
+{
+    PageRef node = pool_.fetch(root_);
+    while (!header(node)->leaf)
+    {
+        const InnerPage* page = inner(node);
+        node = pool_.fetch(page->children[upperBound(page->keys, page->header.count, key)]);
+    }
+    return node;
+}
+
+/**
+* Splits the full page child, the i-th child of parent (which has room),
+* moving its upper half into a new sibling and the separator into parent.
+* A leaf keeps its lower half and copies the sibling's first key up; an
+* inner page moves its middle key up.
+*/
+template<typename Key, typename Value, typename Compare>
+void PagedBTree<Key, Value, Compare>::splitChild(const PageRef& parent, size_t i, const PageRef& child)
+{
+    PageRef sibling = pool_.create();
+    const Key* separator;
+    if (header(child)->leaf)
+    {
+        LeafPage* left = leaf(child);
+        LeafPage* right = leaf(sibling);
+        size_t mid = left->header.count / 2;
+        size_t moved = left->header.count - mid;
+        std::memcpy(right->keys, left->keys + mid, moved * sizeof(Key));
+        std::memcpy(right->values, left->values + mid, moved * sizeof(Value));
+        right->header = PageHeader{1, (uint16_t)moved, left->header.next};
+        left->header.count = (uint16_t)mid;
+        left->header.next = sibling.id();
+        separator = &right->keys[0];
+    }
+    else
+    {
+        InnerPage* left = inner(child);
+        InnerPage* right = inner(sibling);
+        size_t mid = left->header.count / 2;
+        size_t moved = left->header.count - mid - 1;
+        std::memcpy(right->keys, left->keys + mid + 1, moved * sizeof(Key));
+        std::memcpy(right->children, left->children + mid + 1, (moved + 1) * sizeof(PageId));
+        right->header = PageHeader{0, (uint16_t)moved, 0};
+        left->header.count = (uint16_t)mid;
+        separator = &left->keys[mid];
+    }
+
+    InnerPage* page = inner(parent);
+    size_t count = page->header.count;
+    std::memmove(page->keys + i + 1, page->keys + i, (count - i) * sizeof(Key));
+    std::memmove(page->children + i + 2, page->children + i + 1, (count - i) * sizeof(PageId));
+    page->keys[i] = *separator;
+    page->children[i + 1] = sibling.id();
+    ++page->header.count;
+
+    parent.markDirty();
+    child.markDirty();
+    sibling.markDirty();
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the PagedBTree class.
+  ---------------------------------------------
+*/
+
+#endif
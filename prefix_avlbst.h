@@ -0,0 +1,207 @@
+#ifndef PREFIX_AVLBST_H
+#define PREFIX_AVLBST_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "avlbst.h"
+
+/**
+* Customization point for PrefixAVLTree: fills prefix[0..1] with the first
+* 16 bytes of a key as two big-endian words (zero padded), so that
+* comparing prefixes as integers orders keys the same way as comparing the
+* keys, whenever the prefixes differ. Specialize it for other byte-string
+* key types.
+*/
+template <typename Key>
+struct KeyPrefix;
+
+template <>
+struct KeyPrefix<std::string>
+{
+    static void get(const std::string& key, uint64_t prefix[2])
+    {
+        unsigned char bytes[16] = { 0 };
+        std::memcpy(bytes, key.data(), key.size() < 16 ? key.size() : 16);
+        for (int w = 0; w < 2; ++w)
+        {
+            uint64_t word = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                word = (word << 8) | bytes[8 * w + i];
+            }
+            prefix[w] = word;
+        }
+    }
+};
+
+/**
+* An AVL node that also keeps the first 16 bytes of its key inline.
+*/
+template <typename Key, typename Value>
+class PrefixAVLNode : public AVLNode<Key, Value>
+{
+public:
+    PrefixAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+
+    // Returns -1, 0 or 1 as key (whose prefix is given) is less than, equal
+    // to or greater than this node's key. Only looks at the full keys when
+    // the prefixes are equal, and sets fullCompare when it did.
+    int compare(const Key& key, const uint64_t prefix[2], bool& fullCompare) const;
+
+protected:
+    uint64_t prefix_[2];
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the PrefixAVLNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+PrefixAVLNode<Key, Value>::PrefixAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent)
+{
+    KeyPrefix<Key>::get(key, prefix_);
+}
+
+template<class Key, class Value>
+int PrefixAVLNode<Key, Value>::compare(const Key& key, const uint64_t prefix[2], bool& fullCompare) const
+{
+    for (int w = 0; w < 2; ++w)
+    {
+        if (prefix[w] != prefix_[w])
+        {
+            fullCompare = false;
+            return prefix[w] < prefix_[w] ? -1 : 1;
+        }
+    }
+    fullCompare = true;
+    return KeyComparator<std::less<Key> >::compare(std::less<Key>(), key, this->getKey());
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the PrefixAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVLTree for string-like keys whose nodes cache the first 16 bytes of
+* their key. Lookups and the insert descent compare the cached prefixes as
+* two integers, which live in the node itself, and only dereference the
+* keys when the prefixes are equal. Each node is 16 bytes larger than an
+* AVLNode. With BST_STATS, comparisons counts full key comparisons only.
+*/
+template <class Key, class Value>
+class PrefixAVLTree : public AVLTree<Key, Value>
+{
+public:
+    using AVLTree<Key, Value>::insert;
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+
+protected:
+    virtual Node<Key, Value>* internalFind(const Key& key) const;
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual size_t nodeSize() const;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the PrefixAVLTree class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+void PrefixAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    BST_COUNT(inserts, 1);
+    LatencyTimer timer(this->latency_, OP_INSERT);
+    const Key& insertKey = new_item.first;
+    const Value& insertValue = new_item.second;
+
+    if (!this->root_)
+    {
+        this->root_ = this->createNode(insertKey, insertValue, nullptr);
+        return;
+    }
+
+    uint64_t prefix[2];
+    KeyPrefix<Key>::get(insertKey, prefix);
+    PrefixAVLNode<Key, Value>* current = static_cast<PrefixAVLNode<Key, Value>*>(this->root_);
+    while (true)
+    {
+        BST_COUNT(nodeVisits, 1);
+        bool fullCompare = false;
+        int cmp = current->compare(insertKey, prefix, fullCompare);
+        if (fullCompare)
+        {
+            BST_COUNT(comparisons, 1);
+        }
+
+        if (cmp == 0)
+        {
+            this->overwrite(current, insertValue);
+            return;
+        }
+        AVLNode<Key, Value>* next = cmp < 0 ? current->getLeft() : current->getRight();
+        if (!next)
+        {
+            this->attachLeaf(current, this->createNode(insertKey, insertValue, current), cmp < 0);
+            return;
+        }
+        current = static_cast<PrefixAVLNode<Key, Value>*>(next);
+    }
+}
+
+template<class Key, class Value>
+Node<Key, Value>* PrefixAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    uint64_t prefix[2];
+    KeyPrefix<Key>::get(key, prefix);
+    PrefixAVLNode<Key, Value>* current = static_cast<PrefixAVLNode<Key, Value>*>(this->root_);
+    while (current)
+    {
+        BST_COUNT(nodeVisits, 1);
+        bool fullCompare = false;
+        int cmp = current->compare(key, prefix, fullCompare);
+        if (fullCompare)
+        {
+            BST_COUNT(comparisons, 1);
+        }
+
+        if (cmp == 0)
+        {
+            if (current->isTombstone())
+            {
+                return nullptr;
+            }
+            return current;
+        }
+        current = static_cast<PrefixAVLNode<Key, Value>*>(cmp < 0 ? current->getLeft() : current->getRight());
+    }
+    return nullptr;
+}
+
+template<class Key, class Value>
+Node<Key, Value>* PrefixAVLTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    Node<Key, Value>* node = new PrefixAVLNode<Key, Value>(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+    ++this->size_;
+    return node;
+}
+
+template<class Key, class Value>
+size_t PrefixAVLTree<Key, Value>::nodeSize() const
+{
+    return sizeof(PrefixAVLNode<Key, Value>);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the PrefixAVLTree class.
+  -----------------------------------------------
+*/
+
+#endif
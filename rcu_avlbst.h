@@ -0,0 +1,895 @@
+#ifndef RCU_AVLBST_H
+#define RCU_AVLBST_H
+
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include "bst_compare.h"
+
+// Upper bound on the height of an RcuAVLTree (see COMPACT_MAX_HEIGHT).
+#define RCU_MAX_HEIGHT 64
+
+/**
+* A node of RcuAVLTree. Nodes are immutable once the tree has published
+* them: the writer changes a published node by replacing it with a copy.
+* version_ records the update that created the node, so the writer can
+* tell its own unpublished nodes, which it may still modify, from
+* published ones.
+*/
+template <typename Key, typename Value>
+class RcuAVLNode
+{
+public:
+    RcuAVLNode(const std::pair<const Key, Value>& item, RcuAVLNode<Key, Value>* left,
+               RcuAVLNode<Key, Value>* right, int8_t height, uint64_t version);
+
+    const std::pair<const Key, Value>& getItem() const;
+    const Key& getKey() const;
+    RcuAVLNode<Key, Value>* getLeft() const;
+    RcuAVLNode<Key, Value>* getRight() const;
+    int8_t getHeight() const;
+    uint64_t getVersion() const;
+
+    // only for nodes the current update created
+    void setLeft(RcuAVLNode<Key, Value>* left);
+    void setRight(RcuAVLNode<Key, Value>* right);
+    void setHeight(int8_t height);
+    void setValue(const Value& value);
+
+protected:
+    std::pair<const Key, Value> item_;
+    RcuAVLNode<Key, Value>* left_;
+    RcuAVLNode<Key, Value>* right_;
+    int8_t height_;
+    uint64_t version_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the RcuAVLNode class.
+  -----------------------------------------------
+*/
+
+template<typename Key, typename Value>
+RcuAVLNode<Key, Value>::RcuAVLNode(const std::pair<const Key, Value>& item, RcuAVLNode<Key, Value>* left,
+                                   RcuAVLNode<Key, Value>* right, int8_t height, uint64_t version) :
+    item_(item),
+    left_(left),
+    right_(right),
+    height_(height),
+    version_(version)
+{
+
+}
+
+template<typename Key, typename Value>
+const std::pair<const Key, Value>& RcuAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<typename Key, typename Value>
+const Key& RcuAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<typename Key, typename Value>
+RcuAVLNode<Key, Value>* RcuAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+template<typename Key, typename Value>
+RcuAVLNode<Key, Value>* RcuAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+template<typename Key, typename Value>
+int8_t RcuAVLNode<Key, Value>::getHeight() const
+{
+    return height_;
+}
+
+template<typename Key, typename Value>
+uint64_t RcuAVLNode<Key, Value>::getVersion() const
+{
+    return version_;
+}
+
+template<typename Key, typename Value>
+void RcuAVLNode<Key, Value>::setLeft(RcuAVLNode<Key, Value>* left)
+{
+    left_ = left;
+}
+
+template<typename Key, typename Value>
+void RcuAVLNode<Key, Value>::setRight(RcuAVLNode<Key, Value>* right)
+{
+    right_ = right;
+}
+
+template<typename Key, typename Value>
+void RcuAVLNode<Key, Value>::setHeight(int8_t height)
+{
+    height_ = height;
+}
+
+template<typename Key, typename Value>
+void RcuAVLNode<Key, Value>::setValue(const Value& value)
+{
+    item_.second = value;
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the RcuAVLNode class.
+  ---------------------------------------------
+*/
+
+/**
+* An AVL tree for one writer and many readers, where find and iteration
+* take no locks and write nothing shared.
+*
+* Writers never modify a node readers can see. insert and remove copy the
+* nodes on the path they change, and the nodes a rotation touches, then
+* publish the new root with one atomic store. A reader therefore works on
+* whichever complete, balanced version of the tree was current when it
+* loaded the root; an iterator walks one such snapshot from start to end.
+*
+* Replaced nodes are freed by epoch-based reclamation. A reader wraps its
+* lookups in a ReadGuard, which records the current epoch in a slot of its
+* own cache line. Each publish advances the epoch and tags the nodes it
+* replaced with it; the writer frees tagged nodes once every active slot
+* shows that epoch or a later one, since such readers loaded the root after
+* the publish. Nodes, and the items iterators point to, stay valid while
+* the guard lives.
+*
+* insert, remove and clear are serialized by a mutex that readers never
+* touch, so several threads may write, one at a time. An update that
+* throws (a failed allocation, a throwing Value copy) frees the nodes it
+* created and leaves the published tree as it was.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class RcuAVLTree
+{
+public:
+    explicit RcuAVLTree(const Compare& compare = Compare(), size_t readerSlots = 64);
+    ~RcuAVLTree();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    size_t size() const;
+    size_t retiredNodes() const;
+
+    /**
+    * Pins the tree's current epoch for the calling thread. Every find,
+    * begin and iterator use must happen while a guard on the tree lives.
+    * Guards may nest; each takes a reader slot, and a reader waits (lock
+    * free, yielding) if all slots are taken.
+    */
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(const RcuAVLTree<Key, Value, Compare>& tree);
+        ~ReadGuard();
+
+    private:
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        std::atomic<uint64_t>* slot_;
+    };
+
+    /**
+    * An in-order iterator over the snapshot that was current when it was
+    * created. Items are read-only. The root-to-node path is stored inline.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class RcuAVLTree<Key, Value, Compare>;
+        void pushLeftSpine(RcuAVLNode<Key, Value>* node);
+        RcuAVLNode<Key, Value>* current() const;
+
+        RcuAVLNode<Key, Value>* path_[RCU_MAX_HEIGHT];
+        int depth_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+
+protected:
+    typedef RcuAVLNode<Key, Value> NodeT;
+
+    struct ReaderSlot
+    {
+        alignas(64) std::atomic<uint64_t> epoch;  // IDLE when unused
+    };
+
+    static const uint64_t IDLE = UINT64_MAX;
+    static const size_t RECLAIM_BATCH = 64;
+
+    RcuAVLTree(const RcuAVLTree&) = delete;
+    RcuAVLTree& operator=(const RcuAVLTree&) = delete;
+
+    NodeT* makeNode(const std::pair<const Key, Value>& item, NodeT* left, NodeT* right, int8_t height);
+    NodeT* own(NodeT* node);
+    void dispose(NodeT* node);
+    NodeT* insertAt(NodeT* node, const std::pair<const Key, Value>& item, bool& added);
+    NodeT* removeAt(NodeT* node, const Key& key, bool& removed);
+    NodeT* removeMin(NodeT* node, NodeT*& min);
+    NodeT* rebalance(NodeT* node);
+    NodeT* rotateLeft(NodeT* node);
+    NodeT* rotateRight(NodeT* node);
+    void publish(NodeT* root);
+    void abandon();
+    void reclaim();
+    void retireTree(NodeT* root);
+    static int height(const NodeT* node);
+    static void updateHeight(NodeT* node);
+    int heightIfBalanced(const NodeT* root) const;
+    static void destroyTree(NodeT* root);
+
+    std::atomic<NodeT*> root_;
+    std::atomic<size_t> size_;
+    mutable std::atomic<uint64_t> epoch_;
+    ReaderSlot* slots_;
+    size_t numSlots_;
+
+    // writer state, guarded by writeLock_
+    std::mutex writeLock_;
+    uint64_t version_;                              // the update in progress
+    std::vector<NodeT*> replaced_;                  // by the update in progress
+    std::vector<NodeT*> created_;                   // by the update in progress
+    std::deque<std::pair<uint64_t, NodeT*> > limbo_; // retired, by epoch tag
+    Compare compare_;
+};
+
+/*
+  ------------------------------------------------------------
+  Begin implementations for the RcuAVLTree::ReadGuard class.
+  ------------------------------------------------------------
+*/
+
+/**
+* Claims a free slot by swapping the current epoch into it. The CAS is
+* sequentially consistent, so the root this reader loads afterwards is at
+* least as new as that epoch's publish.
+*/
+template<class Key, class Value, class Compare>
+RcuAVLTree<Key, Value, Compare>::ReadGuard::ReadGuard(const RcuAVLTree<Key, Value, Compare>& tree)
+{
+    static thread_local size_t hint = 0;
+    while (true)
+    {
+        uint64_t epoch = tree.epoch_.load();
+        for (size_t i = 0; i < tree.numSlots_; ++i)
+        {
+            size_t s = (hint + i) % tree.numSlots_;
+            uint64_t idle = IDLE;
+            if (tree.slots_[s].epoch.compare_exchange_strong(idle, epoch))
+            {
+                hint = s;
+                slot_ = &tree.slots_[s].epoch;
+                return;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+template<class Key, class Value, class Compare>
+RcuAVLTree<Key, Value, Compare>::ReadGuard::~ReadGuard()
+{
+    slot_->store(IDLE, std::memory_order_release);
+}
+
+/*
+  ----------------------------------------------------------
+  End implementations for the RcuAVLTree::ReadGuard class.
+  ----------------------------------------------------------
+*/
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the RcuAVLTree::iterator class.
+  -----------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+RcuAVLTree<Key, Value, Compare>::iterator::iterator() :
+    depth_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value>& RcuAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return current()->getItem();
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value>* RcuAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(current()->getItem());
+}
+
+template<class Key, class Value, class Compare>
+bool RcuAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return current() == rhs.current();
+}
+
+template<class Key, class Value, class Compare>
+bool RcuAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* The path holds, below the current node, only the ancestors whose left
+* subtree we are in, so the next node is either the leftmost node of the
+* right subtree or the nearest such ancestor.
+*/
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::iterator&
+RcuAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    NodeT* node = path_[--depth_];
+    pushLeftSpine(node->getRight());
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::iterator::pushLeftSpine(RcuAVLNode<Key, Value>* node)
+{
+    while (node)
+    {
+        path_[depth_++] = node;
+        node = node->getLeft();
+    }
+}
+
+template<class Key, class Value, class Compare>
+RcuAVLNode<Key, Value>* RcuAVLTree<Key, Value, Compare>::iterator::current() const
+{
+    return depth_ ? path_[depth_ - 1] : NULL;
+}
+
+/*
+  ---------------------------------------------------------
+  End implementations for the RcuAVLTree::iterator class.
+  ---------------------------------------------------------
+*/
+
+/*
+  ------------------------------------------------
+  Begin implementations for the RcuAVLTree class.
+  ------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+RcuAVLTree<Key, Value, Compare>::RcuAVLTree(const Compare& compare, size_t readerSlots) :
+    root_(NULL), size_(0), epoch_(1), numSlots_(readerSlots ? readerSlots : 1),
+    version_(0), compare_(compare)
+{
+    slots_ = new ReaderSlot[numSlots_];
+    for (size_t i = 0; i < numSlots_; ++i)
+    {
+        slots_[i].epoch.store(IDLE);
+    }
+}
+
+/**
+* No reader may be active when the tree is destroyed.
+*/
+template<class Key, class Value, class Compare>
+RcuAVLTree<Key, Value, Compare>::~RcuAVLTree()
+{
+    destroyTree(root_.load());
+    for (size_t i = 0; i < limbo_.size(); ++i)
+    {
+        delete limbo_[i].second;
+    }
+    delete [] slots_;
+}
+
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::lock_guard<std::mutex> guard(writeLock_);
+    ++version_;
+    bool added = false;
+    try
+    {
+        publish(insertAt(root_.load(std::memory_order_relaxed), keyValuePair, added));
+    }
+    catch (...)
+    {
+        abandon();
+        throw;
+    }
+    if (added)
+    {
+        size_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    std::lock_guard<std::mutex> guard(writeLock_);
+    ++version_;
+    bool removed = false;
+    try
+    {
+        NodeT* root = removeAt(root_.load(std::memory_order_relaxed), key, removed);
+        if (removed)
+        {
+            publish(root);
+        }
+    }
+    catch (...)
+    {
+        abandon();
+        throw;
+    }
+    if (removed)
+    {
+        size_.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::clear()
+{
+    std::lock_guard<std::mutex> guard(writeLock_);
+    ++version_;
+    try
+    {
+        retireTree(root_.load(std::memory_order_relaxed));
+        publish(NULL);
+    }
+    catch (...)
+    {
+        abandon();
+        throw;
+    }
+    size_.store(0, std::memory_order_relaxed);
+}
+
+/**
+* A new node for the current update, recorded so that abandon() can free
+* it if the update fails.
+*/
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::NodeT*
+RcuAVLTree<Key, Value, Compare>::makeNode(const std::pair<const Key, Value>& item, NodeT* left, NodeT* right, int8_t height)
+{
+    created_.reserve(created_.size() + 1);
+    NodeT* node = new NodeT(item, left, right, height, version_);
+    created_.push_back(node);
+    return node;
+}
+
+/**
+* A copy of node the current update may modify: node itself if this update
+* created it, otherwise a fresh copy, with node marked as replaced.
+*/
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::NodeT*
+RcuAVLTree<Key, Value, Compare>::own(NodeT* node)
+{
+    if (node->getVersion() == version_)
+    {
+        return node;
+    }
+    // room first, so that once the copy exists recording it cannot fail
+    replaced_.reserve(replaced_.size() + 1);
+    NodeT* copy = makeNode(node->getItem(), node->getLeft(), node->getRight(), node->getHeight());
+    replaced_.push_back(node);
+    return copy;
+}
+
+/**
+* Drops a node from the tree: frees it now if readers never saw it,
+* otherwise leaves it for reclamation.
+*/
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::dispose(NodeT* node)
+{
+    if (node->getVersion() == version_)
+    {
+        created_.erase(std::find(created_.begin(), created_.end(), node));
+        delete node;
+    }
+    else
+    {
+        replaced_.push_back(node);
+    }
+}
+
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::NodeT*
+RcuAVLTree<Key, Value, Compare>::insertAt(NodeT* node, const std::pair<const Key, Value>& item, bool& added)
+{
+    if (!node)
+    {
+        added = true;
+        return makeNode(item, NULL, NULL, 1);
+    }
+    int cmp = KeyComparator<Compare>::compare(compare_, item.first, node->getKey());
+    node = own(node);
+    if (cmp == 0)
+    {
+        node->setValue(item.second);
+        return node;
+    }
+    if (cmp < 0)
+    {
+        node->setLeft(insertAt(node->getLeft(), item, added));
+    }
+    else
+    {
+        node->setRight(insertAt(node->getRight(), item, added));
+    }
+    return rebalance(node);
+}
+
+/**
+* Removes key from the subtree at node. Nothing is copied unless the key
+* is found.
+*/
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::NodeT*
+RcuAVLTree<Key, Value, Compare>::removeAt(NodeT* node, const Key& key, bool& removed)
+{
+    if (!node)
+    {
+        return NULL;
+    }
+    int cmp = KeyComparator<Compare>::compare(compare_, key, node->getKey());
+    if (cmp != 0)
+    {
+        NodeT* child = removeAt(cmp < 0 ? node->getLeft() : node->getRight(), key, removed);
+        if (!removed)
+        {
+            return node;
+        }
+        node = own(node);
+        if (cmp < 0)
+        {
+            node->setLeft(child);
+        }
+        else
+        {
+            node->setRight(child);
+        }
+        return rebalance(node);
+    }
+
+    removed = true;
+    NodeT* left = node->getLeft();
+    NodeT* right = node->getRight();
+    dispose(node);
+    if (!left || !right)
+    {
+        return left ? left : right;
+    }
+    // replace the node by a copy of its successor
+    NodeT* min = NULL;
+    right = removeMin(right, min);
+    NodeT* replacement = makeNode(min->getItem(), left, right, 1);
+    dispose(min);
+    return rebalance(replacement);
+}
+
+/**
+* Unlinks the smallest node of the subtree and returns it in min (not
+* disposed); returns the new subtree.
+*/
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::NodeT*
+RcuAVLTree<Key, Value, Compare>::removeMin(NodeT* node, NodeT*& min)
+{
+    if (!node->getLeft())
+    {
+        min = node;
+        return node->getRight();
+    }
+    node = own(node);
+    node->setLeft(removeMin(node->getLeft(), min));
+    return rebalance(node);
+}
+
+template<class Key, class Value, class Compare>
+int RcuAVLTree<Key, Value, Compare>::height(const NodeT* node)
+{
+    return node ? node->getHeight() : 0;
+}
+
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::updateHeight(NodeT* node)
+{
+    node->setHeight((int8_t)(1 + std::max(height(node->getLeft()), height(node->getRight()))));
+}
+
+/**
+* Restores the AVL property at an owned node whose children are balanced
+* and differ in height by at most two. Rotated nodes are owned first.
+*/
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::NodeT*
+RcuAVLTree<Key, Value, Compare>::rebalance(NodeT* node)
+{
+    updateHeight(node);
+    int balance = height(node->getLeft()) - height(node->getRight());
+    if (balance > 1)
+    {
+        NodeT* left = node->getLeft();
+        if (height(left->getLeft()) < height(left->getRight()))
+        {
+            node->setLeft(rotateLeft(own(left)));
+        }
+        return rotateRight(node);
+    }
+    if (balance < -1)
+    {
+        NodeT* right = node->getRight();
+        if (height(right->getRight()) < height(right->getLeft()))
+        {
+            node->setRight(rotateRight(own(right)));
+        }
+        return rotateLeft(node);
+    }
+    return node;
+}
+
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::NodeT*
+RcuAVLTree<Key, Value, Compare>::rotateLeft(NodeT* node)
+{
+    NodeT* pivot = own(node->getRight());
+    node->setRight(pivot->getLeft());
+    updateHeight(node);
+    pivot->setLeft(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::NodeT*
+RcuAVLTree<Key, Value, Compare>::rotateRight(NodeT* node)
+{
+    NodeT* pivot = own(node->getLeft());
+    node->setLeft(pivot->getRight());
+    updateHeight(node);
+    pivot->setRight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+/**
+* Makes root the tree readers see, then advances the epoch and tags the
+* nodes this update replaced with the new epoch. Both are sequentially
+* consistent: a reader whose slot shows the new epoch read it after the
+* root store, so it can only have loaded the new root. Only writers move
+* the epoch, so the tag is known up front and the nodes are queued before
+* anything becomes visible; if queuing throws, the update has no effect.
+*/
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::publish(NodeT* root)
+{
+    uint64_t tag = epoch_.load() + 1;
+    size_t queued = limbo_.size();
+    try
+    {
+        for (size_t i = 0; i < replaced_.size(); ++i)
+        {
+            limbo_.push_back(std::make_pair(tag, replaced_[i]));
+        }
+    }
+    catch (...)
+    {
+        limbo_.resize(queued);
+        throw;
+    }
+    root_.store(root);
+    epoch_.fetch_add(1);
+    replaced_.clear();
+    created_.clear();
+    if (limbo_.size() >= RECLAIM_BATCH)
+    {
+        reclaim();
+    }
+}
+
+/**
+* Undoes a failed update: frees the nodes it created, which no reader has
+* seen, and forgets the published nodes it meant to replace, which stay
+* in the tree.
+*/
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::abandon()
+{
+    for (size_t i = 0; i < created_.size(); ++i)
+    {
+        delete created_[i];
+    }
+    created_.clear();
+    replaced_.clear();
+}
+
+/**
+* Frees the retired nodes no reader can still reach: those tagged with an
+* epoch no later than the oldest epoch any active reader shows.
+*/
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::reclaim()
+{
+    uint64_t oldest = IDLE;
+    for (size_t i = 0; i < numSlots_; ++i)
+    {
+        oldest = std::min(oldest, slots_[i].epoch.load());
+    }
+    while (!limbo_.empty() && limbo_.front().first <= oldest)
+    {
+        delete limbo_.front().second;
+        limbo_.pop_front();
+    }
+}
+
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::retireTree(NodeT* root)
+{
+    if (!root)
+    {
+        return;
+    }
+    retireTree(root->getLeft());
+    retireTree(root->getRight());
+    replaced_.push_back(root);
+}
+
+template<class Key, class Value, class Compare>
+void RcuAVLTree<Key, Value, Compare>::destroyTree(NodeT* root)
+{
+    if (!root)
+    {
+        return;
+    }
+    destroyTree(root->getLeft());
+    destroyTree(root->getRight());
+    delete root;
+}
+
+/**
+* The number of items in the latest published version.
+*/
+template<class Key, class Value, class Compare>
+size_t RcuAVLTree<Key, Value, Compare>::size() const
+{
+    return size_.load(std::memory_order_relaxed);
+}
+
+template<class Key, class Value, class Compare>
+bool RcuAVLTree<Key, Value, Compare>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* Replaced nodes not yet freed because a reader may still hold them.
+* Writer side only.
+*/
+template<class Key, class Value, class Compare>
+size_t RcuAVLTree<Key, Value, Compare>::retiredNodes() const
+{
+    return limbo_.size();
+}
+
+/**
+* Checks the snapshot a reader sees; call it under a ReadGuard.
+*/
+template<class Key, class Value, class Compare>
+bool RcuAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    return heightIfBalanced(root_.load()) >= 0;
+}
+
+template<class Key, class Value, class Compare>
+int RcuAVLTree<Key, Value, Compare>::heightIfBalanced(const NodeT* root) const
+{
+    if (!root)
+    {
+        return 0;
+    }
+    int left = heightIfBalanced(root->getLeft());
+    int right = heightIfBalanced(root->getRight());
+    if (left < 0 || right < 0 || left - right > 1 || right - left > 1 ||
+        root->getHeight() != 1 + std::max(left, right))
+    {
+        return -1;
+    }
+    return 1 + std::max(left, right);
+}
+
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::iterator
+RcuAVLTree<Key, Value, Compare>::begin() const
+{
+    iterator it;
+    it.pushLeftSpine(root_.load());
+    return it;
+}
+
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::iterator
+RcuAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns an iterator to key in the current snapshot, or end(). The path
+* keeps only the ancestors the descent left by going left, which is what
+* operator++ expects.
+*/
+template<class Key, class Value, class Compare>
+typename RcuAVLTree<Key, Value, Compare>::iterator
+RcuAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    iterator it;
+    NodeT* node = root_.load();
+    while (node)
+    {
+        int cmp = KeyComparator<Compare>::compare(compare_, key, node->getKey());
+        if (cmp == 0)
+        {
+            it.path_[it.depth_++] = node;
+            return it;
+        }
+        if (cmp < 0)
+        {
+            it.path_[it.depth_++] = node;
+            node = node->getLeft();
+        }
+        else
+        {
+            node = node->getRight();
+        }
+    }
+    return iterator();
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the RcuAVLTree class.
+  ----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,472 @@
+#ifndef SHARDED_AVLBST_H
+#define SHARDED_AVLBST_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <functional>
+#include "avlbst.h"
+
+/**
+* An ordered map split by key range into shards, each an AVLTree behind its
+* own reader-writer lock, so writers to different ranges run in parallel.
+*
+* Shard i holds the keys in [boundary i - 1, boundary i); the first and
+* last shards are open-ended. An operation routes its key with a binary
+* search of the boundary array, locks that one shard and checks the key
+* against the shard's own range, retrying if rebalance() moved the range
+* meanwhile. The boundary array is an immutable snapshot swapped
+* atomically, so routing takes no lock.
+*
+* rebalance() evens out shard sizes online by moving key ranges between
+* neighbouring shards; it locks two shards at a time. Iteration visits all
+* keys in order across shards. An iterator holds a shared lock on the
+* current shard and blocks rebalancing while it lives, so a thread must
+* not modify the tree while it holds one.
+*
+* Key must be default constructible (the shards store their bounds).
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class ShardedAVLTree
+{
+public:
+    typedef AVLTree<Key, Value, Compare> Tree;
+
+    // boundaries.size() + 1 shards; boundaries must be strictly increasing
+    explicit ShardedAVLTree(const std::vector<Key>& boundaries, const Compare& compare = Compare());
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    size_t shards() const;
+    size_t shardSize(size_t shard) const;
+    std::vector<Key> boundaries() const;
+    void rebalance(double tolerance = 0.1);
+
+    /**
+    * An in-order iterator over all shards. Holds shared locks (see the
+    * class comment), so it can be moved but not copied.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class ShardedAVLTree<Key, Value, Compare>;
+        explicit iterator(const ShardedAVLTree<Key, Value, Compare>* tree);
+        void skipEmptyShards();
+
+        const ShardedAVLTree<Key, Value, Compare>* tree_;  // NULL at the end
+        std::shared_lock<std::shared_mutex> layoutLock_;
+        size_t shard_;
+        std::shared_lock<std::shared_mutex> shardLock_;
+        typename Tree::iterator current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+
+private:
+    struct Shard
+    {
+        explicit Shard(const Compare& compare) :
+            tree(compare), hasLow(false), hasHigh(false)
+        {
+
+        }
+
+        mutable std::shared_mutex lock;
+        Tree tree;
+        // the shard holds [low, high); a missing bound is open
+        bool hasLow;
+        bool hasHigh;
+        Key low;
+        Key high;
+    };
+
+    typedef std::vector<Key> Boundaries;
+
+    ShardedAVLTree(const ShardedAVLTree&) = delete;
+    ShardedAVLTree& operator=(const ShardedAVLTree&) = delete;
+
+    bool inRange(const Shard& shard, const Key& key) const;
+    template<typename Lock>
+    Shard& lockShard(const Key& key, Lock& lock) const;
+    void balancePair(size_t left);
+    static void moveItems(Tree& from, Tree& to, size_t first, size_t count);
+
+    std::vector<std::unique_ptr<Shard> > shards_;
+    std::shared_ptr<const Boundaries> boundaries_;  // read with atomic_load
+    // held shared by iterators and exclusively by rebalance
+    mutable std::shared_mutex layoutLock_;
+    Compare compare_;
+};
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the ShardedAVLTree::iterator class.
+  -----------------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+ShardedAVLTree<Key, Value, Compare>::iterator::iterator() :
+    tree_(NULL), shard_(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+ShardedAVLTree<Key, Value, Compare>::iterator::iterator(const ShardedAVLTree<Key, Value, Compare>* tree) :
+    tree_(tree), layoutLock_(tree->layoutLock_), shard_(0),
+    shardLock_(tree->shards_[0]->lock)
+{
+    current_ = tree_->shards_[0]->tree.begin();
+    skipEmptyShards();
+}
+
+/**
+* Moves on to the next shard while the current one is exhausted, releasing
+* every lock once the last shard is done.
+*/
+template<typename Key, typename Value, typename Compare>
+void ShardedAVLTree<Key, Value, Compare>::iterator::skipEmptyShards()
+{
+    while (current_ == tree_->shards_[shard_]->tree.end())
+    {
+        shardLock_.unlock();
+        if (++shard_ == tree_->shards_.size())
+        {
+            layoutLock_.unlock();
+            tree_ = NULL;
+            shard_ = 0;
+            return;
+        }
+        shardLock_ = std::shared_lock<std::shared_mutex>(tree_->shards_[shard_]->lock);
+        current_ = tree_->shards_[shard_]->tree.begin();
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key,Value>& ShardedAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return *current_;
+}
+
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key,Value>* ShardedAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(*current_);
+}
+
+template<typename Key, typename Value, typename Compare>
+bool ShardedAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    if (!tree_ || !rhs.tree_)
+    {
+        return tree_ == rhs.tree_;
+    }
+    return tree_ == rhs.tree_ && shard_ == rhs.shard_ && current_ == rhs.current_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool ShardedAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename ShardedAVLTree<Key, Value, Compare>::iterator&
+ShardedAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    ++current_;
+    skipEmptyShards();
+    return *this;
+}
+
+/*
+  ---------------------------------------------------------
+  End implementations for the ShardedAVLTree::iterator class.
+  ---------------------------------------------------------
+*/
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the ShardedAVLTree class.
+  ---------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+ShardedAVLTree<Key, Value, Compare>::ShardedAVLTree(const std::vector<Key>& boundaries, const Compare& compare) :
+    boundaries_(new Boundaries(boundaries)), compare_(compare)
+{
+    for (size_t i = 1; i < boundaries.size(); ++i)
+    {
+        if (!compare_(boundaries[i - 1], boundaries[i]))
+        {
+            throw std::invalid_argument("Shard boundaries must be strictly increasing");
+        }
+    }
+    for (size_t i = 0; i <= boundaries.size(); ++i)
+    {
+        shards_.push_back(std::unique_ptr<Shard>(new Shard(compare_)));
+        Shard& shard = *shards_.back();
+        if (i > 0)
+        {
+            shard.hasLow = true;
+            shard.low = boundaries[i - 1];
+        }
+        if (i < boundaries.size())
+        {
+            shard.hasHigh = true;
+            shard.high = boundaries[i];
+        }
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+bool ShardedAVLTree<Key, Value, Compare>::inRange(const Shard& shard, const Key& key) const
+{
+    return (!shard.hasLow || !compare_(key, shard.low)) &&
+           (!shard.hasHigh || compare_(key, shard.high));
+}
+
+/**
+* Locks the shard that owns key with lock (a unique_lock or shared_lock)
+* and returns it.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Lock>
+typename ShardedAVLTree<Key, Value, Compare>::Shard&
+ShardedAVLTree<Key, Value, Compare>::lockShard(const Key& key, Lock& lock) const
+{
+    while (true)
+    {
+        std::shared_ptr<const Boundaries> bounds = std::atomic_load(&boundaries_);
+        size_t i = std::upper_bound(bounds->begin(), bounds->end(), key, compare_) - bounds->begin();
+        Shard& shard = *shards_[i];
+        lock = Lock(shard.lock);
+        if (inRange(shard, key))
+        {
+            return shard;
+        }
+        // rebalance() moved the range after we routed
+        lock.unlock();
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+void ShardedAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::unique_lock<std::shared_mutex> lock;
+    lockShard(keyValuePair.first, lock).tree.insert(keyValuePair);
+}
+
+template<typename Key, typename Value, typename Compare>
+void ShardedAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    std::unique_lock<std::shared_mutex> lock;
+    lockShard(key, lock).tree.remove(key);
+}
+
+/**
+* Copies the value for key into value and returns true, or returns false
+* if key is absent. Values are copied out because the shard is unlocked
+* on return.
+*/
+template<typename Key, typename Value, typename Compare>
+bool ShardedAVLTree<Key, Value, Compare>::find(const Key& key, Value& value) const
+{
+    std::shared_lock<std::shared_mutex> lock;
+    const Tree& tree = lockShard(key, lock).tree;
+    typename Tree::iterator it = tree.find(key);
+    if (it == tree.end())
+    {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<typename Key, typename Value, typename Compare>
+void ShardedAVLTree<Key, Value, Compare>::clear()
+{
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+        std::unique_lock<std::shared_mutex> lock(shards_[i]->lock);
+        shards_[i]->tree.clear();
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+bool ShardedAVLTree<Key, Value, Compare>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* The sum of the shard sizes. Shards are counted one at a time, so under
+* concurrent updates this is not an atomic snapshot.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t ShardedAVLTree<Key, Value, Compare>::size() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+        total += shardSize(i);
+    }
+    return total;
+}
+
+template<typename Key, typename Value, typename Compare>
+size_t ShardedAVLTree<Key, Value, Compare>::shards() const
+{
+    return shards_.size();
+}
+
+template<typename Key, typename Value, typename Compare>
+size_t ShardedAVLTree<Key, Value, Compare>::shardSize(size_t shard) const
+{
+    std::shared_lock<std::shared_mutex> lock(shards_[shard]->lock);
+    return shards_[shard]->tree.size();
+}
+
+template<typename Key, typename Value, typename Compare>
+std::vector<Key> ShardedAVLTree<Key, Value, Compare>::boundaries() const
+{
+    return *std::atomic_load(&boundaries_);
+}
+
+/**
+* Evens out the shards by repeatedly halving the size difference of each
+* pair of neighbours, until no shard is more than tolerance (a fraction of
+* the mean) away from the mean size. Other threads keep reading and
+* writing meanwhile; only the two shards being balanced are locked, plus
+* the layout lock that keeps iterators out.
+*/
+template<typename Key, typename Value, typename Compare>
+void ShardedAVLTree<Key, Value, Compare>::rebalance(double tolerance)
+{
+    std::unique_lock<std::shared_mutex> layout(layoutLock_);
+    for (size_t pass = 0; pass < 2 * shards_.size(); ++pass)
+    {
+        size_t total = 0;
+        size_t largest = 0;
+        size_t smallest = (size_t)-1;
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            size_t n = shardSize(i);
+            total += n;
+            largest = std::max(largest, n);
+            smallest = std::min(smallest, n);
+        }
+        double mean = (double)total / shards_.size();
+        double slack = std::max(1.0, tolerance * mean);
+        if (largest <= mean + slack && smallest + slack >= mean)
+        {
+            return;
+        }
+        for (size_t i = 0; i + 1 < shards_.size(); ++i)
+        {
+            balancePair(i);
+        }
+    }
+}
+
+/**
+* Moves half the size difference between shards left and left + 1 across
+* their shared boundary, then publishes the new boundary: the smallest key
+* left in the right shard, which keeps at least half its keys.
+*/
+template<typename Key, typename Value, typename Compare>
+void ShardedAVLTree<Key, Value, Compare>::balancePair(size_t left)
+{
+    Shard& low = *shards_[left];
+    Shard& high = *shards_[left + 1];
+    std::unique_lock<std::shared_mutex> lowLock(low.lock);
+    std::unique_lock<std::shared_mutex> highLock(high.lock);
+
+    size_t lowSize = low.tree.size();
+    size_t highSize = high.tree.size();
+    if (lowSize > highSize + 1)
+    {
+        size_t count = (lowSize - highSize) / 2;
+        moveItems(low.tree, high.tree, lowSize - count, count);
+    }
+    else if (highSize > lowSize + 1)
+    {
+        moveItems(high.tree, low.tree, 0, (highSize - lowSize) / 2);
+    }
+    else
+    {
+        return;
+    }
+
+    const Key& boundary = high.tree.begin()->first;
+    low.high = boundary;
+    high.low = boundary;
+    std::shared_ptr<Boundaries> bounds(new Boundaries(*std::atomic_load(&boundaries_)));
+    (*bounds)[left] = boundary;
+    std::atomic_store(&boundaries_, std::shared_ptr<const Boundaries>(bounds));
+}
+
+/**
+* Moves the count items starting at in-order position first from one tree
+* to the other. The nodes themselves move (see extract), so nothing is
+* allocated and no key or value is copied.
+*/
+template<typename Key, typename Value, typename Compare>
+void ShardedAVLTree<Key, Value, Compare>::moveItems(Tree& from, Tree& to, size_t first, size_t count)
+{
+    typename Tree::iterator it = from.begin();
+    for (size_t i = 0; i < first; ++i)
+    {
+        ++it;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        // extracting a node leaves iterators to the others valid
+        typename Tree::iterator next = it;
+        ++next;
+        to.insert(from.extract(it));
+        it = next;
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+typename ShardedAVLTree<Key, Value, Compare>::iterator
+ShardedAVLTree<Key, Value, Compare>::begin() const
+{
+    return iterator(this);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename ShardedAVLTree<Key, Value, Compare>::iterator
+ShardedAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator();
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the ShardedAVLTree class.
+  -------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,466 @@
+#ifndef UPDATE_PIPELINE_H
+#define UPDATE_PIPELINE_H
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <algorithm>
+#include <utility>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include "avlbst.h"
+
+/**
+* A bounded multi-producer, single-consumer ring buffer (after Vyukov's
+* bounded queue). Each cell carries a sequence number that tells producers
+* when it is free and the consumer when it is filled, so producers only
+* contend on one fetch-and-add-like CAS of the tail and never on a lock.
+* push spins (yielding) while the ring is full.
+*/
+template <typename T>
+class MpscRing
+{
+public:
+    explicit MpscRing(size_t capacity);
+    ~MpscRing();
+
+    // Returns the item's position in the ring's total order: items are
+    // popped in increasing position.
+    uint64_t push(T&& item);
+    // Consumer only. Returns false if the next item is not published yet.
+    bool pop(T& item);
+    // The number of positions handed out so far.
+    uint64_t pushed() const;
+
+private:
+    struct Cell
+    {
+        std::atomic<uint64_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    Cell* cells_;
+    size_t mask_;
+    alignas(64) std::atomic<uint64_t> tail_;
+    alignas(64) uint64_t head_;  // consumer only
+};
+
+/*
+  -------------------------------------------
+  Begin implementations for the MpscRing class.
+  -------------------------------------------
+*/
+
+template<typename T>
+MpscRing<T>::MpscRing(size_t capacity) :
+    tail_(0), head_(0)
+{
+    size_t size = 2;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    cells_ = new Cell[size];
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; ++i)
+    {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+MpscRing<T>::~MpscRing()
+{
+    T item;
+    while (pop(item))
+    {
+
+    }
+    delete [] cells_;
+}
+
+/**
+* A cell at position pos is free for the producer that claimed pos when its
+* sequence equals pos, and filled for the consumer when it equals pos + 1.
+*/
+template<typename T>
+uint64_t MpscRing<T>::push(T&& item)
+{
+    uint64_t pos = tail_.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Cell& cell = cells_[pos & mask_];
+        uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence == pos)
+        {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                new (cell.storage) T(std::move(item));
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return pos;
+            }
+        }
+        else if (sequence < pos)
+        {
+            // full: wait for the consumer to free the cell
+            std::this_thread::yield();
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+bool MpscRing<T>::pop(T& item)
+{
+    Cell& cell = cells_[head_ & mask_];
+    if (cell.sequence.load(std::memory_order_acquire) != head_ + 1)
+    {
+        return false;
+    }
+    T* stored = reinterpret_cast<T*>(cell.storage);
+    item = std::move(*stored);
+    stored->~T();
+    cell.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+    ++head_;
+    return true;
+}
+
+template<typename T>
+uint64_t MpscRing<T>::pushed() const
+{
+    return tail_.load(std::memory_order_acquire);
+}
+
+/*
+  -----------------------------------------
+  End implementations for the MpscRing class.
+  -----------------------------------------
+*/
+
+/**
+* Counters of an UpdatePipeline: updates pushed and applied, how many
+* batches the writer applied them in, and how many tree operations those
+* took after duplicate keys in a batch were folded into one.
+*/
+struct PipelineStats
+{
+    uint64_t updates;
+    uint64_t batches;
+    uint64_t treeOps;
+
+    PipelineStats() :
+        updates(0), batches(0), treeOps(0)
+    {
+
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const PipelineStats& s)
+{
+    os << "updates=" << s.updates << " batches=" << s.batches << " tree_ops=" << s.treeOps;
+    return os;
+}
+
+/**
+* Funnels updates from many threads into one tree through a single writer.
+*
+* insert and remove may be called from any thread: they push the update
+* into an MpscRing and return a future that becomes ready once the update
+* is applied (or holds the exception the tree threw). A dedicated writer
+* thread drains whatever is in the ring as one batch, stable-sorts it by
+* key, folds the updates to each key into the last one, and applies the
+* batch in key order while holding the tree's write lock once. Sorting
+* keeps consecutive descents on the same root-to-leaf paths, which stay in
+* cache.
+*
+* The tree is owned by the pipeline; read it with read(), which holds a
+* shared lock, so any number of readers run between batches. A thread
+* sees its own writes by waiting on their futures, or on sync(), which
+* returns once everything pushed before the call has been applied.
+*
+* Key and Value must be default constructible and movable. Tree must offer
+* insert(pair), remove(key) and keyCompare() (all the BinarySearchTree
+* family does).
+*/
+template <typename Key, typename Value, typename Tree = AVLTree<Key, Value> >
+class UpdatePipeline
+{
+public:
+    explicit UpdatePipeline(size_t ringCapacity = 4096);
+    ~UpdatePipeline();
+
+    std::future<void> insert(const Key& key, const Value& value);
+    std::future<void> remove(const Key& key);
+    void sync();
+
+    // Runs fn(const Tree&) under a shared lock and returns its result.
+    template<typename Function>
+    auto read(Function fn) const -> decltype(fn(std::declval<const Tree&>()));
+
+    PipelineStats stats() const;
+
+private:
+    struct Update
+    {
+        bool remove;
+        Key key;
+        Value value;
+        std::promise<void> done;
+    };
+
+    UpdatePipeline(const UpdatePipeline&) = delete;
+    UpdatePipeline& operator=(const UpdatePipeline&) = delete;
+
+    std::future<void> push(Update&& update);
+    void writerLoop();
+    bool waitForWork();
+    void applyBatch(std::vector<Update>& batch);
+
+    Tree tree_;
+    mutable std::shared_mutex treeLock_;
+    MpscRing<Update> ring_;
+
+    // the writer sleeps on wakeup_ when the ring is empty
+    std::mutex wakeupLock_;
+    std::condition_variable wakeup_;
+    std::atomic<bool> writerSleeping_;
+    std::atomic<bool> stopping_;
+
+    // applied_ updates have been applied, in ring order
+    mutable std::mutex appliedLock_;
+    std::condition_variable appliedChanged_;
+    uint64_t applied_;
+    PipelineStats stats_;
+
+    std::thread writer_;
+};
+
+/*
+  ------------------------------------------------
+  Begin implementations for the UpdatePipeline class.
+  ------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Tree>
+UpdatePipeline<Key, Value, Tree>::UpdatePipeline(size_t ringCapacity) :
+    ring_(ringCapacity), writerSleeping_(false), stopping_(false), applied_(0)
+{
+    writer_ = std::thread(&UpdatePipeline::writerLoop, this);
+}
+
+/**
+* Applies every update already pushed, then stops the writer. No thread
+* may push once destruction has started.
+*/
+template<typename Key, typename Value, typename Tree>
+UpdatePipeline<Key, Value, Tree>::~UpdatePipeline()
+{
+    {
+        std::lock_guard<std::mutex> guard(wakeupLock_);
+        stopping_.store(true);
+    }
+    wakeup_.notify_one();
+    writer_.join();
+}
+
+template<typename Key, typename Value, typename Tree>
+std::future<void> UpdatePipeline<Key, Value, Tree>::insert(const Key& key, const Value& value)
+{
+    Update update;
+    update.remove = false;
+    update.key = key;
+    update.value = value;
+    return push(std::move(update));
+}
+
+template<typename Key, typename Value, typename Tree>
+std::future<void> UpdatePipeline<Key, Value, Tree>::remove(const Key& key)
+{
+    Update update;
+    update.remove = true;
+    update.key = key;
+    return push(std::move(update));
+}
+
+template<typename Key, typename Value, typename Tree>
+std::future<void> UpdatePipeline<Key, Value, Tree>::push(Update&& update)
+{
+    std::future<void> done = update.done.get_future();
+    ring_.push(std::move(update));
+    // pairs with the fence in waitForWork: either the writer sees this
+    // update before sleeping, or we see it asleep and wake it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerSleeping_.load())
+    {
+        std::lock_guard<std::mutex> guard(wakeupLock_);
+        wakeup_.notify_one();
+    }
+    return done;
+}
+
+/**
+* Blocks until every update pushed (by any thread) before the call has
+* been applied.
+*/
+template<typename Key, typename Value, typename Tree>
+void UpdatePipeline<Key, Value, Tree>::sync()
+{
+    uint64_t target = ring_.pushed();
+    std::unique_lock<std::mutex> lock(appliedLock_);
+    appliedChanged_.wait(lock, [&] { return applied_ >= target; });
+}
+
+template<typename Key, typename Value, typename Tree>
+template<typename Function>
+auto UpdatePipeline<Key, Value, Tree>::read(Function fn) const -> decltype(fn(std::declval<const Tree&>()))
+{
+    std::shared_lock<std::shared_mutex> lock(treeLock_);
+    return fn(static_cast<const Tree&>(tree_));
+}
+
+template<typename Key, typename Value, typename Tree>
+PipelineStats UpdatePipeline<Key, Value, Tree>::stats() const
+{
+    std::lock_guard<std::mutex> guard(appliedLock_);
+    return stats_;
+}
+
+template<typename Key, typename Value, typename Tree>
+void UpdatePipeline<Key, Value, Tree>::writerLoop()
+{
+    std::vector<Update> batch;
+    while (true)
+    {
+        Update update;
+        while (ring_.pop(update))
+        {
+            batch.push_back(std::move(update));
+        }
+        if (!batch.empty())
+        {
+            applyBatch(batch);
+            batch.clear();
+        }
+        else if (!waitForWork())
+        {
+            return;
+        }
+    }
+}
+
+/**
+* Sleeps until a producer pushes or the pipeline stops. Returns false to
+* stop, which only happens once the ring is empty.
+*/
+template<typename Key, typename Value, typename Tree>
+bool UpdatePipeline<Key, Value, Tree>::waitForWork()
+{
+    std::unique_lock<std::mutex> lock(wakeupLock_);
+    writerSleeping_.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool more = false;
+    while (true)
+    {
+        // a push that is claimed but not yet published shows up here too
+        more = ring_.pushed() > applied_;
+        if (more || stopping_.load())
+        {
+            break;
+        }
+        wakeup_.wait(lock);
+    }
+    writerSleeping_.store(false);
+    return more;
+}
+
+/**
+* Sorts the batch by key, keeping the push order of updates to the same
+* key, and applies only the last update to each key. Every update's future
+* is then completed, with the exception the tree threw if its tree
+* operation failed.
+*/
+template<typename Key, typename Value, typename Tree>
+void UpdatePipeline<Key, Value, Tree>::applyBatch(std::vector<Update>& batch)
+{
+    const auto compare = tree_.keyCompare();
+    std::stable_sort(batch.begin(), batch.end(),
+                     [&](const Update& a, const Update& b) { return compare(a.key, b.key); });
+
+    size_t treeOps = 0;
+    std::vector<std::exception_ptr> errors(batch.size());
+    {
+        std::unique_lock<std::shared_mutex> lock(treeLock_);
+        size_t first = 0;
+        while (first < batch.size())
+        {
+            size_t last = first + 1;
+            while (last < batch.size() && !compare(batch[first].key, batch[last].key))
+            {
+                ++last;
+            }
+            Update& winner = batch[last - 1];
+            try
+            {
+                if (winner.remove)
+                {
+                    tree_.remove(winner.key);
+                }
+                else
+                {
+                    tree_.insert(std::make_pair(winner.key, winner.value));
+                }
+            }
+            catch (...)
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    errors[i] = std::current_exception();
+                }
+            }
+            ++treeOps;
+            first = last;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(appliedLock_);
+        applied_ += batch.size();
+        ++stats_.batches;
+        stats_.updates += batch.size();
+        stats_.treeOps += treeOps;
+    }
+    appliedChanged_.notify_all();
+
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        if (errors[i])
+        {
+            batch[i].done.set_exception(errors[i]);
+        }
+        else
+        {
+            batch[i].done.set_value();
+        }
+    }
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the UpdatePipeline class.
+  ----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <cstddef>
+
+/**
+* Runs task(0) ... task(numTasks - 1) on `threads` threads (the calling
+* thread is one of them; 0 means one per hardware thread).
+*
+* Each worker starts with a contiguous block of task indices in its own
+* deque and takes work from the front of it. A worker that runs dry steals
+* from the back of another worker's deque, so uneven tasks (e.g. tree chunks
+* of different sizes) still keep every thread busy. No tasks are added after
+* the start, so a worker stops once every deque is empty.
+*
+* The first exception thrown by a task is rethrown in the caller after all
+* threads have finished.
+*/
+class WorkStealingRun
+{
+public:
+    template<typename Task>
+    static void run(size_t numTasks, unsigned threads, Task task)
+    {
+        if (threads == 0)
+        {
+            threads = std::thread::hardware_concurrency();
+        }
+        if (threads == 0)
+        {
+            threads = 1;
+        }
+        if (threads > numTasks)
+        {
+            threads = numTasks ? (unsigned)numTasks : 1;
+        }
+
+        WorkStealingRun state(threads);
+        for (unsigned w = 0; w < threads; ++w)
+        {
+            size_t first = numTasks * w / threads;
+            size_t last = numTasks * (w + 1) / threads;
+            for (size_t t = first; t < last; ++t)
+            {
+                state.queues_[w].tasks.push_back(t);
+            }
+        }
+
+        std::vector<std::thread> workers;
+        for (unsigned w = 1; w < threads; ++w)
+        {
+            workers.push_back(std::thread(&WorkStealingRun::work<Task>, &state, w, task));
+        }
+        state.work(0, task);
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            workers[i].join();
+        }
+
+        if (state.error_)
+        {
+            std::rethrow_exception(state.error_);
+        }
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+
+    explicit WorkStealingRun(unsigned threads) :
+        queues_(threads)
+    {
+
+    }
+
+    template<typename Task>
+    void work(unsigned self, Task task)
+    {
+        size_t t;
+        while (take(self, t))
+        {
+            try
+            {
+                task(t);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(errorLock_);
+                if (!error_)
+                {
+                    error_ = std::current_exception();
+                }
+            }
+        }
+    }
+
+    // Takes the next task from our own deque, or steals one from the back
+    // of another worker's. Returns false when there is no work left anywhere.
+    bool take(unsigned self, size_t& t)
+    {
+        {
+            std::lock_guard<std::mutex> guard(queues_[self].lock);
+            if (!queues_[self].tasks.empty())
+            {
+                t = queues_[self].tasks.front();
+                queues_[self].tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues_.size(); ++i)
+        {
+            Queue& victim = queues_[(self + i) % queues_.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty())
+            {
+                t = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> queues_;
+    std::mutex errorLock_;
+    std::exception_ptr error_;
+};
+
+#endif